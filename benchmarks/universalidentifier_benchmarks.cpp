@@ -0,0 +1,411 @@
+#include "benchmark/benchmark.h"
+
+#include "../src/UniversalIdentifier.hpp"
+
+#include "../tests/mocks.h"
+#include "../tests/JsonTx.h"
+
+namespace
+{
+
+using namespace xmreg;
+
+// same txs as in universalidentifier_tests
+vector<string> const tx_hashes {
+    "ddff95211b53c194a16c2b8f37ae44b643b8bd46b4cb402af961ecabeb8417b2",
+    "f3c84fe925292ec5b4dc383d306d934214f4819611566051bca904d1cf4efceb",
+    "d7dcb2daa64b5718dad71778112d48ad62f4d5f54337037c420cb76efdd8a21c",
+    "61f756a299efd17442eed5437fa03cbda6b01f341907845f8880bf30319fa01c",
+    "ae8f3ad29a40e02dff6a3267c769f08c0af3dc8858683c90ce3ef90212cb7e4b",
+    "140807b970e52b7c633d7ca0ba5be603922aa7a2a1213bdd16d3c1a531402bf6",
+    "a7a4e3bdb305b97c43034440b0bc5125c23b24d0730189261151c0aa3f2a05fc",
+    "c06df274acc273fbce0666b2c8846ac6925a1931fb61e3020b7cc5410d4646b1",
+    "d89f32f1434b6a668cbbc5c55cb1c0c64e41fccb89f6b1eef210fefdacbdd89f",
+    "bd461b938c3c8c8e4d9909852221d5c37350ade05e99ef836d6ccb628f6a5a0e",
+    "f81ecd0381c0b89f23cffe86a799e924af7b5843c663e8c07db98a14e913585e",
+    "386ac4fbf7d3d2ab6fd4f2d9c2e97d00527ca2867e33cd7aedb1fd05a4b791ec",
+    "e658966b256ca30c85848751ff986e3ba7c7cfdadeb46ee1a845a042b3da90db"
+};
+
+/**
+ * Json tx with its mocked blockchain and sender's
+ * PrimaryAccount, all created once for all benchmarks.
+ */
+struct BenchmarkTx
+{
+    JsonTx jtx;
+
+    // MockMicroCore can't be moved
+    unique_ptr<MockMicroCore> mcore;
+
+    // nullptr if the sender is a subaddress
+    unique_ptr<PrimaryAccount> sender_pacc;
+
+    explicit BenchmarkTx(JsonTx _jtx)
+        : jtx {std::move(_jtx)},
+          mcore {make_unique<MockMicroCore>()}
+    {
+        EXPECT_CALL(*mcore, get_output_tx_and_index(_, _, _))
+                .WillRepeatedly(
+                    Invoke(&jtx, &JsonTx::get_output_tx_and_index));
+
+        EXPECT_CALL(*mcore, get_tx(_, _))
+                .WillRepeatedly(
+                    Invoke(&jtx, &JsonTx::get_tx));
+
+        EXPECT_CALL(*mcore, get_output_key(_, _, _))
+                .WillRepeatedly(
+                    Invoke(&jtx, &JsonTx::get_output_key));
+
+        EXPECT_CALL(*mcore, get_num_outputs(_))
+                .WillRepeatedly(Return(1e10));
+
+        if (!jtx.sender.is_subaddress)
+        {
+            // with default lookahead, this has
+            // 10'000 subaddresses
+            sender_pacc = make_primaryaccount(
+                    jtx.sender.address_str(),
+                    pod_to_hex(jtx.sender.viewkey));
+        }
+    }
+};
+
+vector<unique_ptr<BenchmarkTx>> const&
+benchmark_txs()
+{
+    static vector<unique_ptr<BenchmarkTx>> btxs = []()
+    {
+        vector<unique_ptr<BenchmarkTx>> txs;
+
+        for (auto const& tx_hash: tx_hashes)
+        {
+            auto jtx = construct_jsontx(tx_hash, XMREG_TEST_RES_DIR);
+
+            if (!jtx)
+                throw std::runtime_error("Cant construct tx " + tx_hash);
+
+            txs.push_back(make_unique<BenchmarkTx>(std::move(*jtx)));
+        }
+
+        return txs;
+    }();
+
+    return btxs;
+}
+
+/**
+ * Reports number of processed txs and their
+ * outputs (or inputs) per second
+ */
+void
+set_rates(benchmark::State& state,
+          uint64_t no_of_txs,
+          uint64_t no_of_items,
+          string const& items_name = "outputs")
+{
+    state.counters["txs/s"] = benchmark::Counter(
+            no_of_txs, benchmark::Counter::kIsRate);
+
+    state.counters[items_name + "/s"] = benchmark::Counter(
+            no_of_items, benchmark::Counter::kIsRate);
+
+    state.SetItemsProcessed(no_of_txs);
+}
+
+
+template <typename OutputT>
+void
+BM_OutputAddress(benchmark::State& state)
+{
+    auto const& btxs = benchmark_txs();
+
+    uint64_t no_of_txs {0};
+    uint64_t no_of_outputs {0};
+
+    for (auto _: state)
+    {
+        for (auto const& btx: btxs)
+        {
+            auto const& jtx = btx->jtx;
+
+            auto identifier = make_identifier(jtx.tx,
+                  make_unique<OutputT>(&jtx.sender.address,
+                                       &jtx.sender.viewkey));
+
+            identifier.identify();
+
+            benchmark::DoNotOptimize(identifier.get<0>()->get_total());
+
+            ++no_of_txs;
+            no_of_outputs += jtx.tx.vout.size();
+        }
+    }
+
+    set_rates(state, no_of_txs, no_of_outputs);
+}
+
+BENCHMARK_TEMPLATE(BM_OutputAddress, Output);
+BENCHMARK_TEMPLATE(BM_OutputAddress, SoftwareOutput);
+
+
+template <typename OutputT>
+void
+BM_OutputPrimaryAccount(benchmark::State& state)
+{
+    auto const& btxs = benchmark_txs();
+
+    uint64_t no_of_txs {0};
+    uint64_t no_of_outputs {0};
+
+    for (auto _: state)
+    {
+        for (auto const& btx: btxs)
+        {
+            if (!btx->sender_pacc)
+                continue;
+
+            auto const& jtx = btx->jtx;
+
+            auto identifier = make_identifier(jtx.tx,
+                  make_unique<OutputT>(btx->sender_pacc.get()));
+
+            identifier.identify();
+
+            benchmark::DoNotOptimize(identifier.get<0>()->get_total());
+
+            ++no_of_txs;
+            no_of_outputs += jtx.tx.vout.size();
+        }
+    }
+
+    set_rates(state, no_of_txs, no_of_outputs);
+}
+
+BENCHMARK_TEMPLATE(BM_OutputPrimaryAccount, Output);
+BENCHMARK_TEMPLATE(BM_OutputPrimaryAccount, SoftwareOutput);
+
+
+// inputs' benchmarks include overhead of the mocked
+// blockchain. they are to be compared against each other,
+// not against their speed on real blockchain.
+
+template <typename InputT, typename... Args>
+void
+BM_Inputs(benchmark::State& state, Args... args)
+{
+    auto const& btxs = benchmark_txs();
+
+    uint64_t no_of_txs {0};
+    uint64_t no_of_inputs {0};
+
+    for (auto _: state)
+    {
+        for (auto const& btx: btxs)
+        {
+            auto const& jtx = btx->jtx;
+
+            auto identifier = make_identifier(jtx.tx,
+                  make_unique<InputT>(&jtx.sender.address,
+                                      &jtx.sender.viewkey,
+                                      args(jtx)...,
+                                      btx->mcore.get()));
+
+            identifier.identify();
+
+            benchmark::DoNotOptimize(identifier.get<0>()->get_total());
+
+            ++no_of_txs;
+            no_of_inputs += jtx.tx.vin.size();
+        }
+    }
+
+    set_rates(state, no_of_txs, no_of_inputs, "inputs");
+}
+
+void
+BM_GuessInput(benchmark::State& state)
+{
+    BM_Inputs<GuessInput>(state);
+}
+
+BENCHMARK(BM_GuessInput);
+
+void
+BM_RealInput(benchmark::State& state)
+{
+    BM_Inputs<RealInput>(state,
+            [](JsonTx const& jtx) {return &jtx.sender.spendkey;});
+}
+
+BENCHMARK(BM_RealInput);
+
+
+// common combination of identifiers, in ModularIdentifier
+// and FusedIdentifier. identifiers are bound to keys of
+// each tx's sender, so one is built for each tx before
+// the benchmark loop, and reused in all its iterations,
+// as when scanning many txs for the same account.
+
+template <typename MakeIdentifier>
+void
+BM_Identifier(benchmark::State& state, MakeIdentifier make)
+{
+    auto const& btxs = benchmark_txs();
+
+    vector<decltype(make(*btxs.front()))> identifiers;
+
+    for (auto const& btx: btxs)
+        identifiers.push_back(make(*btx));
+
+    uint64_t no_of_txs {0};
+    uint64_t no_of_outputs {0};
+
+    for (auto _: state)
+    {
+        for (size_t i = 0; i < btxs.size(); ++i)
+        {
+            auto const& jtx = btxs[i]->jtx;
+            auto& identifier = identifiers[i];
+
+            // same txs are identified in each iteration, so 
+            // without this only first one would compute
+            // key derivations, unlike when scanning new txs
+            identifier.get_derivation_cache()->clear();
+
+            identifier.identify(jtx.tx);
+
+            benchmark::DoNotOptimize(
+                    identifier.template get<0>()->get_total());
+
+            ++no_of_txs;
+            no_of_outputs += jtx.tx.vout.size();
+        }
+    }
+
+    set_rates(state, no_of_txs, no_of_outputs);
+}
+
+void
+BM_ModularIdentifier(benchmark::State& state)
+{
+    BM_Identifier(state, [](BenchmarkTx const& btx)
+    {
+        auto const& jtx = btx.jtx;
+
+        return make_identifier(
+              make_unique<Output>(&jtx.sender.address,
+                                  &jtx.sender.viewkey),
+              make_unique<GuessInput>(&jtx.sender.address,
+                                      &jtx.sender.viewkey,
+                                      btx.mcore.get()),
+              make_unique<IntegratedPaymentID>(
+                                  &jtx.sender.address,
+                                  &jtx.sender.viewkey));
+    });
+}
+
+BENCHMARK(BM_ModularIdentifier);
+
+void
+BM_FusedIdentifier(benchmark::State& state)
+{
+    BM_Identifier(state, [](BenchmarkTx const& btx)
+    {
+        auto const& jtx = btx.jtx;
+
+        return make_fused_identifier(
+              Output {&jtx.sender.address,
+                      &jtx.sender.viewkey},
+              GuessInput {&jtx.sender.address,
+                          &jtx.sender.viewkey,
+                          btx.mcore.get()},
+              IntegratedPaymentID {&jtx.sender.address,
+                                   &jtx.sender.viewkey});
+    });
+}
+
+BENCHMARK(BM_FusedIdentifier);
+
+
+template <typename PaymentIdT>
+void
+BM_PaymentID(benchmark::State& state)
+{
+    auto const& btxs = benchmark_txs();
+
+    uint64_t no_of_txs {0};
+    uint64_t no_of_outputs {0};
+
+    for (auto _: state)
+    {
+        for (auto const& btx: btxs)
+        {
+            auto const& jtx = btx->jtx;
+            auto const& jrecipient = jtx.recipients.at(0);
+
+            auto identifier = make_identifier(jtx.tx,
+                  make_unique<PaymentIdT>(&jrecipient.address,
+                                          &jrecipient.viewkey));
+
+            identifier.identify();
+
+            benchmark::DoNotOptimize(identifier.get<0>()->get());
+
+            ++no_of_txs;
+            no_of_outputs += jtx.tx.vout.size();
+        }
+    }
+
+    set_rates(state, no_of_txs, no_of_outputs);
+}
+
+BENCHMARK_TEMPLATE(BM_PaymentID, LegacyPaymentID);
+BENCHMARK_TEMPLATE(BM_PaymentID, IntegratedPaymentID);
+
+
+void
+BM_PopulateSubaddressIndices(benchmark::State& state)
+{
+    // monerowalletstagenet3, same as in account_tests
+    string address = "56heRv2ANffW1Py2kBkJDy8xnWqZsSrgjLygwjua2xc8Wbksead1NK1ehaYpjQhymGK4S8NPL9eLuJ16CuEJDag8Hq3RbPV";
+    string viewkey = "b45e6f38b2cd1c667459527decb438cdeadf9c64d93c8bccf40a9bf98943dc09";
+
+    auto last_acc_id = static_cast<uint32_t>(state.range(0));
+
+    uint64_t no_of_subaddresses {0};
+    size_t map_memory_usage {0};
+
+    for (auto _: state)
+    {
+        state.PauseTiming();
+
+        auto acc = make_account(address, viewkey);
+
+        auto pacc = static_cast<PrimaryAccount*>(acc.get());
+
+        state.ResumeTiming();
+
+        pacc->populate_subaddress_indices(0, last_acc_id);
+
+        no_of_subaddresses += pacc->get_subaddress_map().size();
+        map_memory_usage = pacc->get_subaddress_map_memory_usage();
+    }
+
+    state.counters["subaddresses/s"] = benchmark::Counter(
+            no_of_subaddresses, benchmark::Counter::kIsRate);
+
+    // memory used by subaddresses of a single account
+    state.counters["map_bytes"] = benchmark::Counter(
+            map_memory_usage, benchmark::Counter::kDefaults,
+            benchmark::Counter::kIs1024);
+}
+
+BENCHMARK(BM_PopulateSubaddressIndices)
+    ->Arg(1)
+    ->Arg(PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR)
+    ->Unit(benchmark::kMillisecond);
+
+}
+
+BENCHMARK_MAIN();
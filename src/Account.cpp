@@ -1,4 +1,8 @@
 #include "Account.h"
+#include "SubaddressCache.h"
+
+#include <atomic>
+#include <mutex>
 
 namespace xmreg
 {
@@ -103,51 +107,207 @@ PrimaryAccount::add_subaddress_index(uint32_t acc_id, uint32_t addr_id)
     return it.first;
 }
 
-void 
-PrimaryAccount::populate_subaddress_indices(
-        uint32_t start_acc_id,
-        uint32_t last_acc_id)
+namespace
+{
+
+// public spend keys of subaddresses of 
+// a given account (major index)
+struct subaddress_row
 {
+    account_keys const* keys;
+    PrimaryAccount* pacc;
+    uint32_t acc_id;
+    vector<public_key> public_keys;
+};
+
+/**
+ * Generates rows using no_of_threads. Each
+ * thread writes only to rows it took, so no 
+ * locking is needed.
+ */
+void
+generate_subaddress_rows(vector<subaddress_row>& rows,
+                         size_t no_of_threads)
+{
+    if (rows.empty())
+        return;
+
     auto& device = hw::get_device("default");
 
-    auto const& account_keys = *(this->keys());
+    std::atomic<size_t> next_row {0};
+
+    std::mutex m;
+    std::exception_ptr error;
 
-    if (start_acc_id == 0)
+    auto worker = [&]()
     {
-        // first we populate for account of 0 as we 
-        // skip subaddr of 0.
-        auto public_keys = device.get_subaddress_spend_public_keys(
-               account_keys, 0, 1, SUBADDRESS_LOOKAHEAD_MINOR); 
-
-        for (uint32_t addr_id {1}; 
-                addr_id < SUBADDRESS_LOOKAHEAD_MINOR; 
-                ++addr_id)
+        try
+        {
+            for (size_t i; (i = next_row++) < rows.size();)
+            {
+                auto& row = rows[i];
+
+                // we skip subaddr of 0/0, as it is
+                // the primary address
+                uint32_t begin_addr_id = row.acc_id == 0 ? 1 : 0;
+
+                row.public_keys = device.get_subaddress_spend_public_keys(
+                        *row.keys, row.acc_id, begin_addr_id,
+                        PrimaryAccount::SUBADDRESS_LOOKAHEAD_MINOR);
+            }
+        }
+        catch (...)
         {
-            subaddresses.insert({public_keys[addr_id-1], 
-                                {0, addr_id}});
+            std::lock_guard<std::mutex> lk {m};
+
+            if (!error)
+                error = std::current_exception();
+
+            // let other threads finish
+            next_row = rows.size();
         }
-        ++start_acc_id;
-    }
+    };
+
+    no_of_threads = std::min(std::max<size_t>(no_of_threads, 1),
+                             rows.size());
+
+    vector<std::thread> threads;
+
+    // calling thread is also one of the workers
+    for (size_t i = 1; i < no_of_threads; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (auto& t: threads)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+}
+
+void
+PrimaryAccount::add_subaddress_row(
+        uint32_t acc_id, 
+        vector<public_key> const& public_keys)
+{
+    uint32_t addr_id = acc_id == 0 ? 1 : 0;
+
+    for (auto const& public_key: public_keys)
+        subaddresses.insert({public_key, {acc_id, addr_id++}});
+}
+
+void 
+PrimaryAccount::populate_subaddress_indices(
+        uint32_t start_acc_id,
+        uint32_t last_acc_id,
+        size_t no_of_threads)
+{
+    // keys are created on first use,
+    // so get them before threads use them
+    auto const& account_keys = *(this->keys());
+
+    vector<subaddress_row> rows;
 
-    // for all remaning accounts, we generated subaddresses
-    // from 0
     for (uint32_t acc_id {start_acc_id}; 
             acc_id < last_acc_id; ++acc_id)
     {
-       auto public_keys = device.get_subaddress_spend_public_keys(
-               account_keys, acc_id, 0, 
-               SUBADDRESS_LOOKAHEAD_MINOR); 
+        rows.push_back({&account_keys, this, acc_id, {}});
+    }
+
+    generate_subaddress_rows(rows, no_of_threads);
+
+    subaddresses.reserve(subaddresses.size() 
+            + rows.size() * SUBADDRESS_LOOKAHEAD_MINOR);
+
+    for (auto const& row: rows)
+        add_subaddress_row(row.acc_id, row.public_keys);
+
+    next_acc_id_to_populate = last_acc_id;
+}
+
+void
+PrimaryAccount::init_subaddress_indices(
+        uint32_t last_acc_id,
+        size_t no_of_threads)
+{
+    if (next_acc_id_to_populate == 0)
+        load_from_cache();
+
+    if (next_acc_id_to_populate >= last_acc_id)
+        return;
+
+    populate_subaddress_indices(next_acc_id_to_populate, 
+                                last_acc_id, no_of_threads);
+
+    save_to_cache();
+}
+
+bool
+PrimaryAccount::load_from_cache()
+{
+    auto cache = SubaddressCache::get_default();
+
+    if (!cache)
+        return false;
 
-        for (uint32_t addr_id {0}; 
-                addr_id < SUBADDRESS_LOOKAHEAD_MINOR; 
-                ++addr_id)
+    return cache->load(*keys(), SUBADDRESS_LOOKAHEAD_MINOR,
+                       subaddresses, next_acc_id_to_populate);
+}
+
+bool
+PrimaryAccount::save_to_cache()
+{
+    auto cache = SubaddressCache::get_default();
+
+    if (!cache)
+        return false;
+
+    // failing to save only means the subaddresses
+    // will be generated again next time
+    return cache->save(*keys(), SUBADDRESS_LOOKAHEAD_MINOR,
+                       subaddresses, next_acc_id_to_populate);
+}
+
+void
+populate_subaddress_indices(
+        vector<PrimaryAccount*> const& accounts,
+        uint32_t last_acc_id,
+        size_t no_of_threads)
+{
+    vector<subaddress_row> rows;
+
+    for (auto pacc: accounts)
+    {
+        if (pacc->next_acc_id_to_populate == 0)
+            pacc->load_from_cache();
+
+        auto const& account_keys = *(pacc->keys());
+
+        for (uint32_t acc_id {pacc->next_acc_id_to_populate}; 
+                acc_id < last_acc_id; ++acc_id)
         {
-            subaddresses.insert({public_keys[addr_id], 
-                                {acc_id, addr_id}});
+            rows.push_back({&account_keys, pacc, acc_id, {}});
         }
     }
 
-    next_acc_id_to_populate = last_acc_id;
+    generate_subaddress_rows(rows, no_of_threads);
+
+    // maps of different accounts are independent, but 
+    // filling them is cheap compared to generating the keys
+    for (auto const& row: rows)
+        row.pacc->add_subaddress_row(row.acc_id, row.public_keys);
+
+    for (auto pacc: accounts)
+    {
+        if (pacc->next_acc_id_to_populate >= last_acc_id)
+            continue;
+
+        pacc->next_acc_id_to_populate = last_acc_id;
+        pacc->save_to_cache();
+    }
 }
 
 void
@@ -2,9 +2,12 @@
 
 #include "monero_headers.h"
 #include "tools.h"
+#include "SubaddressMap.h"
 
 #include <boost/optional.hpp>
 
+#include <thread>
+
 namespace xmreg
 {
 
@@ -173,9 +176,7 @@ public:
     static constexpr uint32_t SUBADDRESS_LOOKAHEAD_MAJOR {50};
     static constexpr uint32_t SUBADDRESS_LOOKAHEAD_MINOR {200};
 
-    using subaddr_map_t =  std::unordered_map<
-                    public_key,
-                    subaddress_index>;
+    using subaddr_map_t = SubaddressMap;
 
     template <typename... T>
     PrimaryAccount(T&&... args)
@@ -186,7 +187,7 @@ public:
 		// register the PrimaryAccount into
 		// subaddresses map as special case
 		// for uniform handling of all addresses
-		subaddresses[psk()] = *subaddr_idx;
+		subaddresses.insert({psk(), *subaddr_idx});
     }
 
     virtual ADDRESS_TYPE type() const override
@@ -201,15 +202,20 @@ public:
         return gen_subaddress({acc_id, addr_id});
     }
 
-    unique_ptr<subaddress_index>
-    has_subaddress(public_key const& pub_spend_key)
+    /**
+     * Index of subaddress with the given public spend key,
+     * if the key is in the subaddresses map. Does not
+     * allocate, as its called for each checked output.
+     */
+    boost::optional<subaddress_index>
+    has_subaddress(public_key const& pub_spend_key) const
     {
         auto it = subaddresses.find(pub_spend_key);
         
         if (it == subaddresses.end())
-            return nullptr;
+            return boost::none;
 
-        return make_unique<subaddress_index>(it->second);
+        return it->second;
     }
 
     auto get_next_subbaddress_acc_id() const 
@@ -222,6 +228,12 @@ public:
         return subaddresses;
     }
 
+    // bytes used by the subaddresses map
+    auto get_subaddress_map_memory_usage() const
+    {
+        return subaddresses.memory_usage();
+    }
+
     /** 
      * expand subaddress map by to new_acc_id
      */
@@ -239,12 +251,47 @@ public:
     /**
      * Generates all set public spend keys for 
      * 50 accounts x 200 subaddresess into 
-     * subaddresses map
+     * subaddresses map.
+     *
+     * Each account (i.e., major index) is generated
+     * in parallel, and then they are all added
+     * into the map in the calling thread.
      */
     void 
     populate_subaddress_indices(
             uint32_t start_acc_id = 0,
-            uint32_t last_acc_id = SUBADDRESS_LOOKAHEAD_MAJOR);
+            uint32_t last_acc_id = SUBADDRESS_LOOKAHEAD_MAJOR,
+            size_t no_of_threads = std::thread::hardware_concurrency());
+
+    /**
+     * Same as populate_subaddress_indices, but first
+     * loads subaddresses from the default SubaddressCache,
+     * if its set. Only accounts missing from the cache
+     * are generated, and then saved into the cache.
+     */
+    void
+    init_subaddress_indices(
+            uint32_t last_acc_id = SUBADDRESS_LOOKAHEAD_MAJOR,
+            size_t no_of_threads = std::thread::hardware_concurrency());
+
+    /**
+     * Saves subaddresses into the default SubaddressCache,
+     * if its set. populate_subaddress_indices and
+     * expand_subaddresses don't save them, as they
+     * can be called while scanning, e.g., by Output
+     * identifier. So this is to be called after scanning,
+     * e.g., when found outputs are persisted.
+     *
+     * Returns false if the subaddresses were not saved.
+     */
+    bool
+    save_to_cache();
+
+    friend void
+    populate_subaddress_indices(
+            vector<PrimaryAccount*> const& accounts,
+            uint32_t last_acc_id,
+            size_t no_of_threads);
 
 	auto begin() { return subaddresses.begin(); }
     auto begin() const { return subaddresses.cbegin(); }
@@ -253,10 +300,41 @@ public:
     auto end() const { return subaddresses.cend(); }
 
 private:
+
+    // adds generated public spend keys of 
+    // subaddresses of the given account id
+    void
+    add_subaddress_row(uint32_t acc_id, 
+                       vector<public_key> const& public_keys);
+
+    // does nothing if there is no
+    // default SubaddressCache
+    bool
+    load_from_cache();
+
     subaddr_map_t subaddresses; 
     uint32_t next_acc_id_to_populate {0};
 };
 
+/**
+ * Populates subaddresses of many PrimaryAccounts 
+ * up to last_acc_id at once, e.g., when loading 
+ * accounts at startup. 
+ *
+ * Unlike calling populate_subaddress_indices 
+ * for each account, work of all accounts is shared 
+ * by all the threads.
+ *
+ * Accounts which were not populated yet are first 
+ * loaded from the default SubaddressCache, if its set.
+ */
+void
+populate_subaddress_indices(
+        vector<PrimaryAccount*> const& accounts,
+        uint32_t last_acc_id 
+            = PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR,
+        size_t no_of_threads = std::thread::hardware_concurrency());
+
 // account_factory functions are helper functions
 // to easly create Account objects through uniqute_ptr
 
@@ -350,7 +428,7 @@ make_primaryaccount(string const& addr_str,
                     addr_str,
                     std::forward<T>(args)...);
 
-        pacc->populate_subaddress_indices();
+        pacc->init_subaddress_indices();
 
         return pacc;
     }
@@ -386,7 +464,7 @@ make_primaryaccount(std::unique_ptr<Account>&& acc)
 
     unique_ptr<PrimaryAccount> pacc(p);
 
-    pacc->populate_subaddress_indices();
+    pacc->init_subaddress_indices();
 
     return pacc;
 }
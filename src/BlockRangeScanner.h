@@ -0,0 +1,346 @@
+#pragma once
+
+#include "MicroCore.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * Scans blocks in a height range [h1, h2) using
+ * a pool of worker threads.
+ *
+ * The range is split into chunks of blocks. Workers fetch
+ * a chunk's blocks with get_blocks_range and all its txs
+ * with a single get_transactions call, and then execute
+ * scan_f for each block of the chunk. scan_f is where
+ * ModularIdentifiers are to be used, e.g.:
+ *
+ *   BlockRangeScanner<vector<Output::info>> scanner {&mcore};
+ *
+ *   scanner.scan(h1, h2,
+ *       [&](uint64_t height, block const& blk,
+ *           vector<transaction> const& txs)
+ *       {
+ *           vector<Output::info> outputs;
+ *
+ *           for (auto const& tx: txs)
+ *           {
+ *               auto identifier = make_identifier(tx,
+ *                       make_unique<Output>(&address, &viewkey));
+ *               identifier.identify();
+ *               // ... copy identified outputs
+ *           }
+ *
+ *           return outputs;
+ *       },
+ *       [&](uint64_t height, vector<Output::info>& outputs)
+ *       {
+ *           // save outputs
+ *           return true; // false stops the scanning
+ *       });
+ *
+ * Coinbase txs are given only as txs[0], as they are
+ * moved out of their blocks, same as in ChainCursor.
+ *
+ * Workers share the MicroCore, each with its own read
+ * transaction, so their number is limited to 
+ * MicroCore::max_reader_threads().
+ *
+ * Results are passed to result_f in the calling thread,
+ * in the height order. Workers can't get more than
+ * max_chunks_ahead chunks ahead of the result_f, so memory
+ * used for the fetched blocks stays bounded.
+ */
+template <typename Result>
+class BlockRangeScanner
+{
+public:
+
+    // executed in worker threads. txs contain
+    // block's coinbase tx followed by its other txs.
+    // the coinbase tx is moved into txs[0], so blk's 
+    // miner_tx is not to be used.
+    using scan_f_t = std::function<Result(
+                        uint64_t height,
+                        block const& blk,
+                        vector<transaction> const& txs)>;
+
+    // executed in the calling thread, in height order.
+    // returning false stops the scanning
+    using result_f_t = std::function<bool(
+                        uint64_t height,
+                        Result& result)>;
+
+    BlockRangeScanner(MicroCore const* _mcore,
+                      size_t _no_of_threads
+                            = std::thread::hardware_concurrency(),
+                      uint64_t _chunk_size = 100,
+                      size_t _max_chunks_ahead = 0)
+        : mcore {_mcore},
+          no_of_threads {std::min(std::max<size_t>(_no_of_threads, 1),
+                                  MicroCore::max_reader_threads())},
+          chunk_size {std::max<uint64_t>(_chunk_size, 1)},
+          max_chunks_ahead {_max_chunks_ahead > 0
+                                ? _max_chunks_ahead
+                                : 2 * no_of_threads}
+    {}
+
+    /**
+     * Scans blocks from h1 up to, but not including, h2.
+     *
+     * Returns false if the scanning was stopped by
+     * result_f. Exceptions thrown in workers, e.g.,
+     * when txs can't be found, are rethrown here.
+     */
+    bool
+    scan(uint64_t h1, uint64_t h2,
+         scan_f_t scan_f, result_f_t result_f) const;
+
+private:
+
+    struct chunk
+    {
+        vector<Result> results;
+        std::exception_ptr error;
+    };
+
+    chunk
+    process_chunk(uint64_t from, uint64_t to,
+                  scan_f_t const& scan_f) const;
+
+    MicroCore const* mcore {nullptr};
+    size_t no_of_threads;
+    uint64_t chunk_size;
+    size_t max_chunks_ahead;
+};
+
+
+template <typename Result>
+typename BlockRangeScanner<Result>::chunk
+BlockRangeScanner<Result>::process_chunk(
+        uint64_t from, uint64_t to,
+        scan_f_t const& scan_f) const
+{
+    chunk c;
+
+    try
+    {
+        // all reads of the chunk, including those made
+        // by identifiers in scan_f, use one read transaction
+        ReadSnapshot snapshot {mcore};
+
+        // get_blocks_range includes its last height
+        auto blocks = mcore->get_blocks_range(from, to - 1);
+
+        if (blocks.size() != to - from)
+        {
+            throw std::runtime_error(
+                    "Cant get blocks from " + std::to_string(from)
+                    + " to " + std::to_string(to - 1));
+        }
+
+        // fetch txs of all blocks in the chunk at once
+        vector<crypto::hash> tx_hashes;
+
+        for (auto const& blk: blocks)
+            tx_hashes.insert(tx_hashes.end(),
+                             blk.tx_hashes.begin(),
+                             blk.tx_hashes.end());
+
+        vector<transaction> chunk_txs;
+        vector<crypto::hash> missed_txs;
+
+        if (!tx_hashes.empty())
+        {
+            if (!mcore->get_transactions(tx_hashes, chunk_txs, missed_txs)
+                    || !missed_txs.empty()
+                    || chunk_txs.size() != tx_hashes.size())
+            {
+                throw std::runtime_error(
+                        "Cant get txs of blocks from "
+                        + std::to_string(from)
+                        + " to " + std::to_string(to - 1));
+            }
+        }
+
+        c.results.reserve(blocks.size());
+
+        auto tx_it = chunk_txs.begin();
+
+        vector<transaction> txs;
+
+        for (uint64_t i = 0; i < blocks.size(); ++i)
+        {
+            auto& blk = blocks[i];
+
+            txs.clear();
+            txs.reserve(blk.tx_hashes.size() + 1);
+
+            // blk.miner_tx is left moved-from
+            txs.push_back(std::move(blk.miner_tx));
+
+            auto tx_end = tx_it + blk.tx_hashes.size();
+
+            std::move(tx_it, tx_end, std::back_inserter(txs));
+
+            tx_it = tx_end;
+
+            c.results.push_back(scan_f(from + i, blk, txs));
+        }
+    }
+    catch (...)
+    {
+        c.error = std::current_exception();
+    }
+
+    return c;
+}
+
+template <typename Result>
+bool
+BlockRangeScanner<Result>::scan(
+        uint64_t h1, uint64_t h2,
+        scan_f_t scan_f, result_f_t result_f) const
+{
+    if (h2 <= h1)
+        return true;
+
+    uint64_t const no_of_chunks = (h2 - h1 + chunk_size - 1) / chunk_size;
+
+    std::mutex m;
+    std::condition_variable cv_fetch;
+    std::condition_variable cv_ready;
+
+    // all below are guarded by the mutex m
+    uint64_t next_chunk_to_fetch {0};
+    uint64_t next_chunk_to_deliver {0};
+    bool stop {false};
+    std::map<uint64_t, chunk> ready_chunks;
+
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            uint64_t chunk_no;
+
+            {
+                std::unique_lock<std::mutex> lk {m};
+
+                cv_fetch.wait(lk, [&]()
+                {
+                    return stop
+                        || next_chunk_to_fetch >= no_of_chunks
+                        || next_chunk_to_fetch
+                            < next_chunk_to_deliver + max_chunks_ahead;
+                });
+
+                if (stop || next_chunk_to_fetch >= no_of_chunks)
+                    return;
+
+                chunk_no = next_chunk_to_fetch++;
+            }
+
+            uint64_t from = h1 + chunk_no * chunk_size;
+            uint64_t to = std::min(from + chunk_size, h2);
+
+            auto c = process_chunk(from, to, scan_f);
+
+            {
+                std::lock_guard<std::mutex> lk {m};
+                ready_chunks.emplace(chunk_no, std::move(c));
+            }
+
+            cv_ready.notify_all();
+        }
+    };
+
+    vector<std::thread> workers;
+
+    auto no_of_workers = std::min<uint64_t>(no_of_threads, no_of_chunks);
+
+    for (size_t i = 0; i < no_of_workers; ++i)
+        workers.emplace_back(worker);
+
+    auto stop_workers = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lk {m};
+            stop = true;
+        }
+
+        cv_fetch.notify_all();
+
+        for (auto& w: workers)
+            w.join();
+
+        workers.clear();
+    };
+
+    bool scanned_all {true};
+
+    try
+    {
+        for (uint64_t chunk_no = 0;
+                chunk_no < no_of_chunks && scanned_all;
+                ++chunk_no)
+        {
+            chunk c;
+
+            {
+                std::unique_lock<std::mutex> lk {m};
+
+                cv_ready.wait(lk, [&]()
+                {
+                    return ready_chunks.count(chunk_no) > 0;
+                });
+
+                auto it = ready_chunks.find(chunk_no);
+
+                c = std::move(it->second);
+
+                ready_chunks.erase(it);
+
+                next_chunk_to_deliver = chunk_no + 1;
+            }
+
+            // workers can fetch next chunk now
+            cv_fetch.notify_all();
+
+            if (c.error)
+                std::rethrow_exception(c.error);
+
+            uint64_t height = h1 + chunk_no * chunk_size;
+
+            for (auto& result: c.results)
+            {
+                if (!result_f(height++, result))
+                {
+                    scanned_all = false;
+                    break;
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        stop_workers();
+        throw;
+    }
+
+    stop_workers();
+
+    return scanned_all;
+}
+
+}
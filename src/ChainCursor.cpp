@@ -0,0 +1,195 @@
+#include "ChainCursor.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace xmreg
+{
+
+ChainCursor::ChainCursor(MicroCore const* _mcore,
+                         uint64_t _h1, uint64_t _h2,
+                         uint64_t _max_blocks_ahead,
+                         uint64_t _batch_size)
+    : mcore {_mcore},
+      h1 {_h1},
+      h2 {std::max(_h1, _h2)},
+      max_blocks_ahead {std::max<uint64_t>(_max_blocks_ahead, 1)},
+      batch_size {std::max<uint64_t>(_batch_size, 1)}
+{
+    prefetcher = std::thread {&ChainCursor::prefetch, this};
+}
+
+ChainCursor::~ChainCursor()
+{
+    {
+        std::lock_guard<std::mutex> lk {m};
+        stop = true;
+    }
+
+    cv_consumed.notify_all();
+
+    prefetcher.join();
+}
+
+unique_ptr<ChainCursor::entry>
+ChainCursor::get_free_entry()
+{
+    {
+        std::lock_guard<std::mutex> lk {m};
+
+        if (!free_entries.empty())
+        {
+            auto e = std::move(free_entries.back());
+            free_entries.pop_back();
+            return e;
+        }
+    }
+
+    return make_unique<entry>();
+}
+
+void
+ChainCursor::fetch_batch(uint64_t from, uint64_t to)
+{
+    // blocks and their txs are read
+    // in one read transaction
+    ReadSnapshot snapshot {mcore};
+
+    // get_blocks_range includes its last height
+    auto blocks = mcore->get_blocks_range(from, to - 1);
+
+    if (blocks.size() != to - from)
+    {
+        throw std::runtime_error(
+                "Cant get blocks from " + std::to_string(from)
+                + " to " + std::to_string(to - 1));
+    }
+
+    vector<crypto::hash> tx_hashes;
+
+    for (auto const& blk: blocks)
+        tx_hashes.insert(tx_hashes.end(),
+                         blk.tx_hashes.begin(),
+                         blk.tx_hashes.end());
+
+    vector<transaction> batch_txs;
+    vector<crypto::hash> missed_txs;
+
+    if (!tx_hashes.empty())
+    {
+        if (!mcore->get_transactions(tx_hashes, batch_txs, missed_txs)
+                || !missed_txs.empty()
+                || batch_txs.size() != tx_hashes.size())
+        {
+            throw std::runtime_error(
+                    "Cant get txs of blocks from "
+                    + std::to_string(from)
+                    + " to " + std::to_string(to - 1));
+        }
+    }
+
+    auto tx_it = batch_txs.begin();
+
+    for (uint64_t i = 0; i < blocks.size(); ++i)
+    {
+        auto e = get_free_entry();
+
+        e->height = from + i;
+        e->blk = std::move(blocks[i]);
+
+        // clear keeps capacity of the recycled entry's
+        // vector. txs are parsed anew, and only moved here
+        e->txs.clear();
+        e->txs.push_back(std::move(e->blk.miner_tx));
+
+        auto tx_end = tx_it + e->blk.tx_hashes.size();
+
+        std::move(tx_it, tx_end, std::back_inserter(e->txs));
+
+        tx_it = tx_end;
+
+        {
+            std::lock_guard<std::mutex> lk {m};
+            ready_entries.push_back(std::move(e));
+        }
+
+        cv_ready.notify_one();
+    }
+}
+
+void
+ChainCursor::prefetch()
+{
+    try
+    {
+        for (uint64_t from = h1; from < h2; from += batch_size)
+        {
+            {
+                std::unique_lock<std::mutex> lk {m};
+
+                cv_consumed.wait(lk, [&]()
+                {
+                    return stop
+                        || ready_entries.size() < max_blocks_ahead;
+                });
+
+                if (stop)
+                    break;
+            }
+
+            fetch_batch(from, std::min(from + batch_size, h2));
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lk {m};
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lk {m};
+        done = true;
+    }
+
+    cv_ready.notify_one();
+}
+
+ChainCursor::entry const*
+ChainCursor::next()
+{
+    std::unique_lock<std::mutex> lk {m};
+
+    if (current)
+        free_entries.push_back(std::move(current));
+
+    cv_ready.wait(lk, [&]()
+    {
+        return !ready_entries.empty() || done;
+    });
+
+    if (ready_entries.empty())
+    {
+        // blocks fetched before an error are
+        // given first, so the error is
+        // reported at its height
+        if (error)
+        {
+            auto e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+
+        return nullptr;
+    }
+
+    current = std::move(ready_entries.front());
+    ready_entries.pop_front();
+
+    lk.unlock();
+
+    cv_consumed.notify_one();
+
+    return current.get();
+}
+
+}
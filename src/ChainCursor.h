@@ -0,0 +1,114 @@
+#pragma once
+
+#include "MicroCore.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * Forward cursor over blocks in a height range [h1, h2),
+ * e.g., for sequential scanning of the whole chain:
+ *
+ *   ChainCursor cursor {&mcore, h1, h2};
+ *
+ *   while (auto entry = cursor.next())
+ *   {
+ *       for (auto const& tx: entry->txs)
+ *           identifier.identify(tx);
+ *   }
+ *
+ * A background thread fetches blocks in batches with
+ * get_blocks_range, and all txs of a batch with a single
+ * get_transactions call, so that they are ready before
+ * they are needed. It stays at most max_blocks_ahead
+ * blocks (plus one batch) ahead of the consumer.
+ *
+ * Entries given by next() are recycled, so that the entries
+ * and storage of their tx vectors are not allocated again
+ * for each block. The txs themselves are not reused, as
+ * get_transactions parses new ones, which are moved
+ * into the vectors.
+ *
+ * The cursor is to be used by a single thread. For scanning
+ * with many threads use BlockRangeScanner.
+ */
+class ChainCursor
+{
+public:
+
+    struct entry
+    {
+        uint64_t height;
+
+        // its miner_tx is moved into txs
+        block blk;
+
+        // block's coinbase tx followed by its other txs
+        vector<transaction> txs;
+    };
+
+    ChainCursor(MicroCore const* _mcore,
+                uint64_t _h1, uint64_t _h2,
+                uint64_t _max_blocks_ahead = 200,
+                uint64_t _batch_size = 20);
+
+    ChainCursor(ChainCursor const&) = delete;
+    ChainCursor& operator=(ChainCursor const&) = delete;
+
+    /**
+     * Returns next block with its txs, or nullptr if
+     * there are no more blocks. The entry is valid till
+     * next call. Exceptions from the background
+     * thread, e.g., when txs can't be found, are
+     * rethrown here.
+     */
+    entry const*
+    next();
+
+    ~ChainCursor();
+
+private:
+
+    void
+    prefetch();
+
+    void
+    fetch_batch(uint64_t from, uint64_t to);
+
+    unique_ptr<entry>
+    get_free_entry();
+
+    MicroCore const* mcore {nullptr};
+
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t max_blocks_ahead;
+    uint64_t batch_size;
+
+    // entry given to the consumer by last next()
+    unique_ptr<entry> current;
+
+    std::mutex m;
+    std::condition_variable cv_consumed;
+    std::condition_variable cv_ready;
+
+    // all below are guarded by the mutex m
+    std::deque<unique_ptr<entry>> ready_entries;
+    vector<unique_ptr<entry>> free_entries;
+    bool stop {false};
+    bool done {false};
+    std::exception_ptr error;
+
+    std::thread prefetcher;
+};
+
+}
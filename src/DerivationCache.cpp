@@ -0,0 +1,44 @@
+#include "DerivationCache.h"
+
+namespace xmreg
+{
+
+DerivationCache::DerivationCache(size_t _capacity)
+    : max_size {std::max<size_t>(_capacity, 1)}
+{}
+
+bool
+DerivationCache::get(public_key const& pub_key,
+                     secret_key const& viewkey,
+                     key_derivation& derivation)
+{
+    // hashing viewkey is much cheaper than
+    // generating derivation
+    key_t key {pub_key, cn_fast_hash(&viewkey, sizeof(viewkey))};
+
+    auto it = derivations.find(key);
+
+    if (it != derivations.end())
+    {
+        ++no_of_hits;
+        derivation = it->second;
+        return true;
+    }
+
+    ++no_of_misses;
+
+    if (!generate_key_derivation(pub_key, viewkey, derivation))
+        return false;
+
+    // derivations are usually needed only for txs
+    // scanned recently, so instead of tracking which
+    // one is the oldest, just start over when full
+    if (derivations.size() >= max_size)
+        derivations.clear();
+
+    derivations.emplace(key, derivation);
+
+    return true;
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "MicroCore.h"
+
+#include <unordered_map>
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * Cache of key derivations, i.e., results of 
+ * generate_key_derivation(tx_pub_key, viewkey).
+ *
+ * Getting derivation requires scalar multiplication, 
+ * which is the most expensive thing done when 
+ * identifying a tx. But the same derivation is needed
+ * by Output, PaymentID and Inputs' mixin outputs. So 
+ * identifiers sharing this cache compute it only once. 
+ *
+ * Viewkeys are identified by their hashes, so that the
+ * cache does not keep copies of secret keys. Their
+ * addresses can't be used, as a viewkey of other 
+ * account can be later at the same address.
+ *
+ * The cache is not thread-safe. Each thread should
+ * have its own one, e.g., in its ModularIdentifier.
+ */
+class DerivationCache
+{
+public:
+
+    explicit DerivationCache(size_t _capacity = 1'000);
+
+    /**
+     * Sets derivation for the given public key
+     * and viewkey. Computes it if its not cached yet.
+     *
+     * Returns false if derivation can't be generated.
+     */
+    bool
+    get(public_key const& pub_key,
+        secret_key const& viewkey,
+        key_derivation& derivation);
+
+    inline auto size() const {return derivations.size();}
+
+    inline auto capacity() const {return max_size;}
+
+    inline void clear() {derivations.clear();}
+
+    inline uint64_t hits() const {return no_of_hits;}
+    inline uint64_t misses() const {return no_of_misses;}
+
+private:
+
+    // public key and hash of viewkey
+    using key_t = pair<public_key, crypto::hash>;
+
+    struct key_hash
+    {
+        size_t
+        operator()(key_t const& key) const
+        {
+            return std::hash<public_key>()(key.first)
+                    ^ std::hash<crypto::hash>()(key.second);
+        }
+    };
+
+    size_t max_size;
+
+    unordered_map<key_t, key_derivation, key_hash> derivations;
+
+    uint64_t no_of_hits {0};
+    uint64_t no_of_misses {0};
+};
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "MicroCore.h"
+
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * Scans txs in the mempool incrementally.
+ *
+ * Each poll gets only hashes of txs in the mempool and
+ * compares them with txs seen before. Only newly
+ * arrived txs are read and scanned with scan_f, where
+ * ModularIdentifiers are to be used, e.g.:
+ *
+ *   MempoolWatcher<vector<Output::info>> watcher {&mcore,
+ *       [&](crypto::hash const& tx_hash, transaction const& tx)
+ *       {
+ *           identifier.identify(tx);
+ *           return identifier.get<Output>()->get();
+ *       }};
+ *
+ *   for (;;)
+ *   {
+ *       watcher.poll(
+ *           [&](crypto::hash const& tx_hash,
+ *               vector<Output::info> const& outputs)
+ *           {
+ *               // tx arrived into the mempool
+ *           },
+ *           [&](crypto::hash const& tx_hash,
+ *               vector<Output::info> const& outputs)
+ *           {
+ *               // tx left the mempool, mined or dropped
+ *           });
+ *
+ *       std::this_thread::sleep_for(1s);
+ *   }
+ *
+ * Results of txs still in the mempool are kept, so
+ * the cost of a poll depends on how many txs
+ * arrived since the last one, not on the mempool size.
+ *
+ * The watcher is not thread-safe. It is to be
+ * polled from a single thread.
+ */
+template <typename Result>
+class MempoolWatcher
+{
+public:
+
+    using scan_f_t = std::function<Result(
+                        crypto::hash const& tx_hash,
+                        transaction const& tx)>;
+
+    // used for both, added and removed txs
+    using event_f_t = std::function<void(
+                        crypto::hash const& tx_hash,
+                        Result const& result)>;
+
+    MempoolWatcher(MicroCore const* _mcore, scan_f_t _scan_f)
+        : mcore {_mcore}, scan_f {std::move(_scan_f)}
+    {}
+
+    /**
+     * Scans txs which arrived since the last poll
+     * and forgets those which left the mempool.
+     * removed_f is called for removed txs first,
+     * and then added_f for new ones.
+     *
+     * Returns false if the mempool can't be read.
+     */
+    bool
+    poll(event_f_t const& added_f = nullptr,
+         event_f_t const& removed_f = nullptr);
+
+    /**
+     * Results of all txs in the mempool
+     * as of the last poll
+     */
+    inline auto const& get_results() const {return results;}
+
+    inline auto size() const {return results.size();}
+
+    // number of txs scanned by the last poll
+    inline auto no_of_scanned() const {return last_no_of_scanned;}
+
+private:
+
+    MicroCore const* mcore {nullptr};
+
+    scan_f_t scan_f;
+
+    unordered_map<crypto::hash, Result> results;
+
+    // reused by each poll
+    vector<crypto::hash> tx_hashes;
+    unordered_set<crypto::hash> pending;
+    transaction tx;
+
+    size_t last_no_of_scanned {0};
+};
+
+
+template <typename Result>
+bool
+MempoolWatcher<Result>::poll(event_f_t const& added_f,
+                             event_f_t const& removed_f)
+{
+    if (!mcore->get_mempool_tx_hashes(tx_hashes))
+        return false;
+
+    pending.clear();
+    pending.insert(tx_hashes.begin(), tx_hashes.end());
+
+    for (auto it = results.begin(); it != results.end();)
+    {
+        if (pending.count(it->first))
+        {
+            ++it;
+            continue;
+        }
+
+        if (removed_f)
+            removed_f(it->first, it->second);
+
+        it = results.erase(it);
+    }
+
+    last_no_of_scanned = 0;
+
+    for (auto const& tx_hash: tx_hashes)
+    {
+        if (results.count(tx_hash))
+            continue;
+
+        // tx could have left the mempool since we
+        // got its hash. if so, next poll won't see it
+        if (!mcore->get_mempool_tx(tx_hash, tx))
+            continue;
+
+        auto it = results.emplace(tx_hash, scan_f(tx_hash, tx)).first;
+
+        ++last_no_of_scanned;
+
+        if (added_f)
+            added_f(it->first, it->second);
+    }
+
+    return true;
+}
+
+}
@@ -4,10 +4,22 @@
 
 #include "MicroCore.h"
 
+#include "common/util.h"
+
 
 namespace xmreg
 {
 
+size_t
+MicroCore::max_reader_threads()
+{
+    // same size as set by BlockchainLMDB::open, unless 
+    // monerod was run with different --max-concurrency
+    auto no_of_reader_slots = tools::get_max_concurrency() + 16;
+
+    return std::max<size_t>(no_of_reader_slots / 2, 1);
+}
+
 /**
  * The constructor is interesting, as
  * m_mempool and m_blockchain_storage depend
@@ -80,6 +92,8 @@ MicroCore::init(const string& _blockchain_path, network_type nt)
         return false;
     }
 
+    db_pruned = core_storage.get_db().get_blockchain_pruning_seed() != 0;
+
     initialization_succeded = true;
 
     return true;
@@ -140,7 +154,42 @@ MicroCore::get_transactions(
         std::vector<transaction>& txs,
         std::vector<crypto::hash>& missed_txs) const
 {
-    return core_storage.get_transactions(txs_ids, txs, missed_txs);
+    // txs are read straight from the db, rather than with 
+    // Blockchain::get_transactions, which locks the blockchain
+    // and so makes threads scanning in parallel wait for 
+    // each other. pruned txs are returned without
+    // their prunable part, instead of being missed.
+    //
+    // this is used for whole blocks when scanning, so
+    // missed txs are only reported in missed_txs, without
+    // logging each of them, as get_tx does.
+    ReadSnapshot snapshot {this};
+
+    static thread_local cryptonote::blobdata tx_blob;
+
+    txs.reserve(txs.size() + txs_ids.size());
+
+    for (auto const& tx_hash: txs_ids)
+    {
+        bool is_pruned;
+
+        txs.emplace_back();
+
+        bool parsed = get_tx_blob(tx_hash, tx_blob, is_pruned)
+                && (is_pruned
+                    ? parse_and_validate_tx_base_from_blob(tx_blob, 
+                                                           txs.back())
+                    : parse_and_validate_tx_from_blob(tx_blob, 
+                                                      txs.back()));
+
+        if (!parsed)
+        {
+            txs.pop_back();
+            missed_txs.push_back(tx_hash);
+        }
+    }
+
+    return true;
 }
 
 
@@ -219,6 +268,46 @@ MicroCore::get_mempool_txs(
   }
 }
 
+bool
+MicroCore::get_mempool_tx_hashes(
+        std::vector<crypto::hash>& tx_hashes) const
+{
+  try
+  {
+      tx_hashes.clear();
+      m_mempool.get_transaction_hashes(tx_hashes);
+      return true;
+  }
+  catch (std::exception const& e)
+  {
+      std::cerr << e.what() << std::endl;
+      return false;
+  }
+}
+
+bool
+MicroCore::get_mempool_tx(
+        crypto::hash const& tx_hash, transaction& tx) const
+{
+    // same txs as get_mempool_txs gives, i.e., 
+    // without not yet relayed ones
+    static thread_local cryptonote::blobdata tx_blob;
+
+    try
+    {
+        if (!m_mempool.get_transaction(tx_hash, tx_blob,
+                                       relay_category::broadcasted))
+            return false;
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+
+    return parse_and_validate_tx_from_blob(tx_blob, tx);
+}
+
 uint64_t
 MicroCore::get_current_blockchain_height() const
 {
@@ -238,6 +327,122 @@ MicroCore::get_output_tx_and_index(
                 amount, offsets, indices);
 }
 
+bool
+AbstractCore::get_pruned_tx(crypto::hash const& tx_hash, 
+                            transaction& tx) const
+{
+    return get_tx(tx_hash, tx);
+}
+
+void
+AbstractCore::get_output_keys(
+        vector<ring_t> const& rings,
+        vector<vector<output_data_t>>& outputs) const
+{
+    // resized, not cleared, to reuse
+    // vectors of previous calls
+    outputs.resize(rings.size());
+
+    for (auto i = 0u; i < rings.size(); ++i)
+    {
+        outputs[i].clear();
+        get_output_key(rings[i].first, rings[i].second, outputs[i]);
+    }
+}
+
+void
+AbstractCore::get_output_tx_and_indices(
+        vector<ring_t> const& rings,
+        vector<vector<tx_out_index>>& indices) const
+{
+    indices.resize(rings.size());
+
+    for (auto i = 0u; i < rings.size(); ++i)
+    {
+        indices[i].clear();
+        get_output_tx_and_index(rings[i].first, rings[i].second,
+                                indices[i]);
+    }
+}
+
+bool
+AbstractCore::start_read_txn() const
+{
+    return false;
+}
+
+void
+AbstractCore::stop_read_txn() const
+{
+}
+
+bool
+MicroCore::start_read_txn() const
+{
+    return core_storage.get_db().block_rtxn_start();
+}
+
+void
+MicroCore::stop_read_txn() const
+{
+    core_storage.get_db().block_rtxn_stop();
+}
+
+/**
+ * Gets public keys of ring members of all the rings
+ * at once.
+ *
+ * Ring members are sorted and deduplicated first,
+ * so that lmdb is read in order, with one get_output_key
+ * call per amount, all in one read transaction, rather 
+ * than one per key image.
+ *
+ * This can THROW if any of the ring members is not found.
+ */
+void
+MicroCore::get_output_keys(
+        vector<ring_t> const& rings,
+        vector<vector<output_data_t>>& outputs) const
+{
+    // if a read transaction is already open in this
+    // thread, e.g., for a whole block, it is reused
+    ReadSnapshot snapshot {this};
+
+    fetch_ring_members(rings, outputs,
+        [this](uint64_t amount, vector<uint64_t> const& offsets,
+               vector<output_data_t>& amount_outputs)
+        {
+            core_storage.get_db().get_output_key(
+                        epee::span<const uint64_t>(&amount, 1),
+                        offsets, amount_outputs);
+        });
+}
+
+/**
+ * Gets tx hashes and output indices in the txs of
+ * ring members of all the rings at once.
+ *
+ * lmdb's get_output_tx_and_index works for one amount
+ * only, so ring members are grouped by amount. All amounts
+ * are then read in one read transaction. For rct inputs
+ * this is just a single get_output_tx_and_index call.
+ */
+void
+MicroCore::get_output_tx_and_indices(
+        vector<ring_t> const& rings,
+        vector<vector<tx_out_index>>& indices) const
+{
+    ReadSnapshot snapshot {this};
+
+    fetch_ring_members(rings, indices,
+        [this](uint64_t amount, vector<uint64_t> const& offsets,
+               vector<tx_out_index>& amount_indices)
+        {
+            core_storage.get_db().get_output_tx_and_index(
+                        amount, offsets, amount_indices);
+        });
+}
+
 bool
 MicroCore::get_block_from_height(uint64_t height, block& blk) const
 {
@@ -274,16 +479,24 @@ MicroCore::get_block_complete_entry(block const& b, block_complete_entry& bce)
 {
     bce.block = cryptonote::block_to_blob(b);
 
+    bce.txs.reserve(bce.txs.size() + b.tx_hashes.size());
+
+    ReadSnapshot snapshot {this};
+
     for (const auto &tx_hash: b.tx_hashes)
     {
-      transaction tx;
+      // blobs are read straight into the entry, as they are 
+      // stored in the blockchain, rather than parsed into txs
+      // and serialized back. pruned txs have only their 
+      // pruned blobs, which is what tx_to_blob gave for them.
+      bce.txs.emplace_back();
 
-      if (!get_tx(tx_hash, tx))
-        return false;
+      auto& txblob = bce.txs.back().blob;
 
-      cryptonote::blobdata txblob =  tx_to_blob(tx);
+      bool is_pruned;
 
-      bce.txs.push_back(txblob);
+      if (!get_tx_blob(tx_hash, txblob, is_pruned))
+        return false;
     }
 
     return true;
@@ -292,34 +505,121 @@ MicroCore::get_block_complete_entry(block const& b, block_complete_entry& bce)
 bool
 MicroCore::get_tx(crypto::hash const& tx_hash, transaction& tx) const
 {
-    if (core_storage.have_tx(tx_hash))
+    bool is_pruned;
+    return get_tx(tx_hash, tx, is_pruned);
+}
+
+bool
+MicroCore::get_tx_blob(crypto::hash const& tx_hash, blobdata& tx_blob,
+                       bool& is_pruned) const
+{
+    auto const& db = core_storage.get_db();
+
+    is_pruned = false;
+
+    // on a full node, get_tx_blob is a single lookup for 
+    // all txs. it returns false, instead of throwing, when 
+    // the tx does not exist or its prunable part is missing,
+    // e.g., if the db has been pruned after init.
+    if (!db_pruned && db.get_tx_blob(tx_hash, tx_blob))
+        return true;
+
+    // on a pruned node, most txs have no prunable part, so
+    // the pruned part is read first and the prunable one
+    // appended to it if it is still kept. this is what 
+    // get_tx_blob does as well, but without its failed 
+    // lookup for each pruned tx.
+    if (!db.get_pruned_tx_blob(tx_hash, tx_blob))
+        return false;
+
+    static thread_local cryptonote::blobdata prunable_blob;
+
+    if (db.get_prunable_tx_blob(tx_hash, prunable_blob))
     {
-        // get transaction with given hash
-        try
-        {
-            tx = core_storage.get_db().get_tx(tx_hash);
-        }
-        catch (TX_DNE const& e)
-        {
-            try 
-            {
-                // coinbase txs are not considered pruned
-                tx = core_storage.get_db().get_pruned_tx(tx_hash);
-                return true;
-            }
-            catch (TX_DNE const& e)
-            {
-                cerr << "MicroCore::get_tx: " << e.what() << endl;
-            }
+        tx_blob.append(prunable_blob);
+        return true;
+    }
+
+    is_pruned = true;
+
+    return true;
+}
+
+bool
+MicroCore::get_tx(crypto::hash const& tx_hash, transaction& tx,
+                  bool& is_pruned) const
+{
+    // the blob is only needed till the tx is parsed, so
+    // its buffer is reused by next calls in the same thread
+    static thread_local cryptonote::blobdata tx_blob;
 
+    if (!get_tx_blob(tx_hash, tx_blob, is_pruned))
+    {
+        cerr << "MicroCore::get_tx tx does not exist in blockchain: " 
+             << tx_hash << endl;
+        return false;
+    }
+
+    if (is_pruned)
+    {
+        if (!parse_and_validate_tx_base_from_blob(tx_blob, tx))
+        {
+            cerr << "MicroCore::get_tx: cant parse pruned tx: " 
+                 << tx_hash << endl;
             return false;
         }
+
+        return true;
     }
-    else
+
+    if (!parse_and_validate_tx_from_blob(tx_blob, tx))
+    {
+        cerr << "MicroCore::get_tx: cant parse tx: " 
+             << tx_hash << endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool
+MicroCore::get_pruned_tx(crypto::hash const& tx_hash, 
+                         transaction& tx) const
+{
+    static thread_local cryptonote::blobdata tx_blob;
+
+    if (!get_pruned_tx_blob(tx_hash, tx_blob))
     {
-        cerr << "MicroCore::get_tx tx does not exist in blockchain: " << tx_hash << endl;
+        cerr << "MicroCore::get_pruned_tx tx does not exist in blockchain: " 
+             << tx_hash << endl;
         return false;
-    }     
+    }
+
+    return parse_and_validate_tx_base_from_blob(tx_blob, tx);
+}
+
+bool
+MicroCore::get_pruned_tx_blob(crypto::hash const& tx_hash, 
+                              blobdata& tx_blob) const
+{
+    // pruned part is always there, on pruned 
+    // and full nodes, so its a single lookup
+    return core_storage.get_db().get_pruned_tx_blob(tx_hash, tx_blob);
+}
+
+bool
+MicroCore::get_pruned_tx_blobs(vector<crypto::hash> const& tx_hashes, 
+                               vector<blobdata>& tx_blobs) const
+{
+    tx_blobs.resize(tx_hashes.size());
+
+    ReadSnapshot snapshot {this};
+
+    for (size_t i = 0; i < tx_hashes.size(); ++i)
+    {
+        if (!get_pruned_tx_blob(tx_hashes[i], tx_blobs[i]))
+            return false;
+    }
 
     return true;
 }
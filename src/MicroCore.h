@@ -7,6 +7,9 @@
 
 #include "monero_headers.h"
 
+#include <algorithm>
+#include <map>
+
 namespace xmreg
 {
 using namespace cryptonote;
@@ -42,12 +45,175 @@ class AbstractCore
     virtual bool
     get_tx(crypto::hash const& tx_hash, transaction& tx) const = 0;
 
+    // tx without its prunable part, i.e., only its prefix 
+    // and ringct base fields. enough to identify its outputs.
+    // the default implementation just calls get_tx
+    virtual bool
+    get_pruned_tx(crypto::hash const& tx_hash, transaction& tx) const;
+
+    // amount and absolute offsets of ring members of a key image
+    using ring_t = pair<uint64_t, vector<uint64_t>>;
+
+    // batched versions of get_output_key and get_output_tx_and_index
+    // for rings of all inputs in a tx, or even in a whole block.
+    // outputs[i] and indices[i] correspond to rings[i].
+    // the default implementations just call the two methods above
+    // for each ring.
+
+    virtual void
+    get_output_keys(vector<ring_t> const& rings,
+                    vector<vector<output_data_t>>& outputs) const;
+
+    virtual void
+    get_output_tx_and_indices(
+            vector<ring_t> const& rings,
+            vector<vector<tx_out_index>>& indices) const;
+
+    // open and close a read transaction of the blockchain
+    // db, reused by all reads in the calling thread till it 
+    // is closed. start_read_txn returns false if the thread
+    // already has one open, which then must not be closed.
+    // ReadSnapshot is to be used instead of these.
+    // the default implementations do nothing.
+
+    virtual bool
+    start_read_txn() const;
+
+    virtual void
+    stop_read_txn() const;
+
     // below, with time we can other pure virtual methods 
     // to the AbstractCore, if needed. For now, the above three are 
     // essential
 
 };
 
+/**
+ * Gets values, e.g., output keys, of ring members of 
+ * all the rings at once. values[i][j] is for the j-th
+ * member of rings[i].
+ *
+ * Ring members are grouped by amount, sorted and 
+ * deduplicated first, so that 
+ *
+ *   fetch(amount, offsets, amount_values)
+ *
+ * is called once for each amount only, with offsets in 
+ * increasing order, e.g., to read lmdb in order. It must 
+ * set amount_values[k] for offsets[k]. For rct inputs
+ * this is just a single fetch.
+ *
+ * Throws if fetch does not give a value for each offset.
+ */
+template <typename T, typename FetchF>
+void
+fetch_ring_members(vector<AbstractCore::ring_t> const& rings,
+                   vector<vector<T>>& values,
+                   FetchF&& fetch)
+{
+    std::map<uint64_t, vector<uint64_t>> offsets_by_amount;
+
+    for (auto const& ring: rings)
+    {
+        auto& offsets = offsets_by_amount[ring.first];
+        offsets.insert(offsets.end(),
+                       ring.second.begin(), ring.second.end());
+    }
+
+    std::map<uint64_t, vector<T>> values_by_amount;
+
+    for (auto& amount_offsets: offsets_by_amount)
+    {
+        auto& offsets = amount_offsets.second;
+
+        std::sort(offsets.begin(), offsets.end());
+
+        offsets.erase(std::unique(offsets.begin(), offsets.end()),
+                      offsets.end());
+
+        auto& amount_values = values_by_amount[amount_offsets.first];
+
+        fetch(amount_offsets.first, offsets, amount_values);
+
+        if (amount_values.size() != offsets.size())
+            throw std::runtime_error(
+                    "Cant get all ring members of amount "
+                    + std::to_string(amount_offsets.first));
+    }
+
+    // resized, not cleared, to reuse
+    // vectors of previous calls
+    values.resize(rings.size());
+
+    for (size_t i = 0; i < rings.size(); ++i)
+    {
+        auto const& ring = rings[i];
+        auto& ring_values = values[i];
+
+        ring_values.clear();
+
+        auto const& offsets = offsets_by_amount.at(ring.first);
+        auto const& amount_values = values_by_amount.at(ring.first);
+
+        for (auto const& offset: ring.second)
+        {
+            auto it = std::lower_bound(offsets.begin(), offsets.end(),
+                                       offset);
+
+            ring_values.push_back(
+                    amount_values[std::distance(offsets.begin(), it)]);
+        }
+    }
+}
+
+/**
+ * Keeps a read transaction of the blockchain db open 
+ * for its lifetime, e.g., for a whole block or a tx, 
+ * so that all MicroCore reads in the thread use it, 
+ * instead of each opening and closing its own one.
+ * All these reads see the same state of the db.
+ *
+ *   {
+ *       ReadSnapshot snapshot {&mcore};
+ *
+ *       // all reads here share one transaction
+ *   }
+ *
+ * Snapshots can be nested. Only the outermost one
+ * closes the transaction.
+ *
+ * Same as lmdb's read transactions, it is for
+ * the thread which created it only. It should not be
+ * held for long, as lmdb can't reuse pages freed
+ * by writes made while it is open.
+ */
+class ReadSnapshot
+{
+public:
+
+    explicit ReadSnapshot(AbstractCore const* _mcore)
+        : mcore {_mcore},
+          owns_txn {mcore->start_read_txn()}
+    {}
+
+    ReadSnapshot(ReadSnapshot const&) = delete;
+    ReadSnapshot& operator=(ReadSnapshot const&) = delete;
+
+    ~ReadSnapshot()
+    {
+        if (owns_txn)
+            mcore->stop_read_txn();
+    }
+
+    // false if an outer snapshot has the transaction
+    inline bool is_outermost() const {return owns_txn;}
+
+private:
+
+    AbstractCore const* mcore;
+    bool owns_txn;
+};
+
 /**
  * Micro version of cryptonode::core class
  * Micro version of constructor,
@@ -55,6 +221,26 @@ class AbstractCore
  *
  * Just enough to read the blockchain
  * database for use in the example.
+ *
+ * One MicroCore can be shared by many threads reading
+ * the blockchain, e.g., by BlockRangeScanner's workers,
+ * instead of each thread or process opening the db 
+ * again. Its const blockchain read methods (get_tx, 
+ * get_transactions, get_output_key, get_output_tx_and_index,
+ * get_num_outputs, get_blocks_range and their batched 
+ * versions) don't change any shared state. The db gives 
+ * each thread its own read transaction. 
+ *
+ * Each thread which has read the db keeps a slot 
+ * in lmdb's reader table till it exits. The table is 
+ * shared with monerod, and its size is set by the process 
+ * which opens the db first. monero sets it to
+ * tools::get_max_concurrency() + 16, so on a 4 core host 
+ * there are only 20 slots. No more than max_reader_threads() 
+ * threads should read at once.
+ *
+ * init and the methods using the mempool are not
+ * to be used concurrently with the above.
  */
 class MicroCore : public AbstractCore 
 {
@@ -70,8 +256,28 @@ class MicroCore : public AbstractCore
 
     bool initialization_succeded {false};
 
+    // set by init. on pruned nodes txs are read by their
+    // pruned and prunable parts, instead of first trying
+    // get_tx_blob, which fails for all pruned txs
+    bool db_pruned {false};
+
+    // blob of the whole tx, or of its pruned part only,
+    // with is_pruned set, if its prunable part has been
+    // pruned from the blockchain
+    bool
+    get_tx_blob(crypto::hash const& tx_hash, blobdata& tx_blob,
+                bool& is_pruned) const;
+
 public:
 
+    /**
+     * lmdb reader slots left for our threads. Half of
+     * the reader table, as sized by monero, is left for 
+     * monerod and other processes reading the db. 
+     */
+    static size_t
+    max_reader_threads();
+
     //   <amoumt,
     //    tuple<total_instances, unlocked_instances, recent_instances>
     using histogram_map = std::map<uint64_t,
@@ -116,6 +322,11 @@ public:
     get_output_key(uint64_t amount,
                    uint64_t global_amount_index) const; 
 
+    // txs found are appended to txs, in order of txs_ids,
+    // and the ones not found to missed_txs, without any
+    // logging. unlike Blockchain::get_transactions, pruned
+    // txs are not missed, but returned base-only, i.e., 
+    // only with their prefix and ringct base fields.
     virtual bool
     get_transactions(
             std::vector<crypto::hash> const& txs_ids,
@@ -151,6 +362,16 @@ public:
     virtual bool
     get_mempool_txs(std::vector<transaction>& txs) const;
 
+    // hashes of all txs in the mempool, without reading
+    // the txs themselves, e.g., for MempoolWatcher
+    virtual bool
+    get_mempool_tx_hashes(std::vector<crypto::hash>& tx_hashes) const;
+
+    // returns false if the tx is not in the mempool,
+    // e.g., it has been mined in the meantime
+    virtual bool
+    get_mempool_tx(crypto::hash const& tx_hash, transaction& tx) const;
+
     virtual uint64_t
     get_current_blockchain_height() const;
 
@@ -163,6 +384,22 @@ public:
             std::vector<uint64_t> const& offsets,
             std::vector<tx_out_index>& indices) const override;
 
+    virtual void
+    get_output_keys(vector<ring_t> const& rings,
+                    vector<vector<output_data_t>>& outputs)
+                    const override;
+
+    virtual void
+    get_output_tx_and_indices(
+            vector<ring_t> const& rings,
+            vector<vector<tx_out_index>>& indices) const override;
+
+    virtual bool
+    start_read_txn() const override;
+
+    virtual void
+    stop_read_txn() const override;
+
     virtual bool
     get_output_histogram(
             vector<uint64_t> const& amounts,
@@ -195,6 +432,33 @@ public:
     virtual bool
     get_tx(crypto::hash const& tx_hash, transaction& tx) const override;
 
+    // same as above, but sets is_pruned to true if the tx is 
+    // returned without its prunable part, as it has been 
+    // pruned from the blockchain
+    virtual bool
+    get_tx(crypto::hash const& tx_hash, transaction& tx, 
+           bool& is_pruned) const;
+
+    virtual bool
+    get_pruned_tx(crypto::hash const& tx_hash, 
+                  transaction& tx) const override;
+
+    // blob of the tx prefix and its ringct base, e.g.,
+    // for ScanTx. tx_blob is overwritten, so the same 
+    // blob can be used for many txs
+    virtual bool
+    get_pruned_tx_blob(crypto::hash const& tx_hash, 
+                       blobdata& tx_blob) const;
+
+    // pruned blobs of many txs, e.g., of a whole block.
+    // tx_blobs[i] is for tx_hashes[i]. strings in tx_blobs are
+    // overwritten, not reallocated, so the same vector
+    // should be used for next blocks. 
+    // returns false if any of the txs does not exist
+    virtual bool
+    get_pruned_tx_blobs(vector<crypto::hash> const& tx_hashes, 
+                        vector<blobdata>& tx_blobs) const;
+
     virtual bool
     decrypt_payment_id(crypto::hash8& payment_id,
                        public_key const& public_key,
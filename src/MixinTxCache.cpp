@@ -0,0 +1,137 @@
+#include "MixinTxCache.h"
+
+namespace xmreg
+{
+
+MixinTxCache::MixinTxCache(size_t _capacity)
+    : max_size {std::max<size_t>(_capacity, 1)}
+{
+    entries.reserve(max_size);
+}
+
+shared_ptr<transaction const>
+MixinTxCache::get_tx(crypto::hash const& tx_hash,
+                     AbstractCore const* mcore)
+{
+    {
+        std::lock_guard<std::mutex> lk {m};
+
+        auto it = entries.find(tx_hash);
+
+        if (it != entries.end())
+        {
+            ++tx_hits;
+            touch(it->second);
+            return it->second.tx;
+        }
+    }
+
+    ++tx_misses;
+
+    // fetch the tx without locking the cache, as
+    // this is the slow part. if other thread fetches
+    // same tx in the meantime, we just use its one.
+    auto tx = make_shared<transaction>();
+
+    // only outputs of mixin txs are needed
+    if (!mcore->get_pruned_tx(tx_hash, *tx))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lk {m};
+
+    auto it = entries.find(tx_hash);
+
+    if (it != entries.end())
+    {
+        touch(it->second);
+        return it->second.tx;
+    }
+
+    if (entries.size() >= max_size)
+    {
+        // remove least recently used tx
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+
+    lru.push_front(tx_hash);
+
+    entries.emplace(tx_hash, entry {tx, {}, lru.begin()});
+
+    return tx;
+}
+
+bool
+MixinTxCache::get_outputs(crypto::hash const& tx_hash,
+                          account_key_t const& acc_key,
+                          vector<Output::info>& outputs)
+{
+    std::lock_guard<std::mutex> lk {m};
+
+    auto it = entries.find(tx_hash);
+
+    if (it != entries.end())
+    {
+        for (auto const& acc_outputs: it->second.outputs)
+        {
+            if (acc_outputs.first != acc_key)
+                continue;
+
+            ++outputs_hits;
+            touch(it->second);
+            outputs = acc_outputs.second;
+            return true;
+        }
+    }
+
+    ++outputs_misses;
+
+    return false;
+}
+
+void
+MixinTxCache::set_outputs(crypto::hash const& tx_hash,
+                          account_key_t const& acc_key,
+                          vector<Output::info> outputs)
+{
+    std::lock_guard<std::mutex> lk {m};
+
+    auto it = entries.find(tx_hash);
+
+    if (it == entries.end())
+        return;
+
+    for (auto& acc_outputs: it->second.outputs)
+    {
+        if (acc_outputs.first == acc_key)
+        {
+            acc_outputs.second = std::move(outputs);
+            return;
+        }
+    }
+
+    it->second.outputs.emplace_back(acc_key, std::move(outputs));
+}
+
+size_t
+MixinTxCache::size() const
+{
+    std::lock_guard<std::mutex> lk {m};
+    return entries.size();
+}
+
+void
+MixinTxCache::clear()
+{
+    std::lock_guard<std::mutex> lk {m};
+    entries.clear();
+    lru.clear();
+}
+
+void
+MixinTxCache::touch(entry& e)
+{
+    lru.splice(lru.begin(), lru, e.lru_pos);
+}
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "UniversalIdentifier.hpp"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * LRU cache of mixin txs used by GuessInput and RealInput.
+ *
+ * Same txs are used as ring members in many inputs of
+ * many txs. So instead of fetching them from the 
+ * blockchain and looking for our outputs in them over and
+ * over again, we keep the txs and identified outputs
+ * of each account here.
+ *
+ * The cache is thread-safe, so it can be shared between
+ * identifiers running in different threads.
+ *
+ * Outputs found for PrimaryAccount are for subaddresses
+ * which the account had when the tx was scanned. 
+ */
+class MixinTxCache
+{
+public:
+
+    // public spend and view keys of an account and 
+    // whether its subaddresses were also searched for.
+    // outputs are identified with the viewkey, so accounts
+    // with same spend key and different viewkeys don't
+    // share them.
+    using account_key_t = tuple<public_key, public_key, bool>;
+
+    explicit MixinTxCache(size_t _capacity = 10'000);
+
+    /**
+     * Returns tx of the given hash. If its not in the 
+     * cache, it is fetched using mcore and cached. Only
+     * outputs of mixin txs are needed, so txs are fetched
+     * without their prunable part.
+     *
+     * Returns nullptr if the tx can't be fetched.
+     */
+    shared_ptr<transaction const>
+    get_tx(crypto::hash const& tx_hash,
+           AbstractCore const* mcore);
+
+    /**
+     * Returns true and sets outputs if outputs
+     * for the given account and tx are cached
+     */
+    bool
+    get_outputs(crypto::hash const& tx_hash,
+                account_key_t const& acc_key,
+                vector<Output::info>& outputs);
+
+    /**
+     * Saves outputs for the given account and tx.
+     * Does nothing if the tx is not in the cache.
+     */
+    void
+    set_outputs(crypto::hash const& tx_hash,
+                account_key_t const& acc_key,
+                vector<Output::info> outputs);
+
+    size_t
+    size() const;
+
+    void
+    clear();
+
+    inline auto capacity() const {return max_size;}
+
+    // stats of get_tx
+    inline uint64_t hits() const {return tx_hits;}
+    inline uint64_t misses() const {return tx_misses;}
+
+    // stats of get_outputs
+    inline uint64_t output_hits() const {return outputs_hits;}
+    inline uint64_t output_misses() const {return outputs_misses;}
+
+private:
+
+    struct entry
+    {
+        shared_ptr<transaction const> tx;
+        vector<pair<account_key_t, vector<Output::info>>> outputs;
+        list<crypto::hash>::iterator lru_pos;
+    };
+
+    // moves the entry to the front of the lru list
+    void
+    touch(entry& e);
+
+    size_t max_size;
+
+    mutable std::mutex m;
+
+    // most recently used txs are at the front
+    list<crypto::hash> lru;
+    unordered_map<crypto::hash, entry> entries;
+
+    std::atomic<uint64_t> tx_hits {0};
+    std::atomic<uint64_t> tx_misses {0};
+    std::atomic<uint64_t> outputs_hits {0};
+    std::atomic<uint64_t> outputs_misses {0};
+};
+
+}
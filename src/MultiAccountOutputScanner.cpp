@@ -0,0 +1,55 @@
+#include "MultiAccountOutputScanner.h"
+
+namespace xmreg
+{
+
+MultiAccountOutputScanner::MultiAccountOutputScanner(
+        vector<Account*> const& accounts)
+{
+    identifiers.reserve(accounts.size());
+
+    for (auto acc: accounts)
+        add(acc);
+}
+
+void
+MultiAccountOutputScanner::add(Account* acc)
+{
+    identifiers.emplace_back(acc);
+}
+
+void
+MultiAccountOutputScanner::add(
+        address_parse_info const* address,
+        secret_key const* viewkey)
+{
+    identifiers.emplace_back(address, viewkey);
+}
+
+void
+MultiAccountOutputScanner::scan(transaction const& tx)
+{
+    // same as in ModularIdentifier, we parse tx 
+    // extra only once for all accounts
+    tx_extra.set(tx);
+
+    scan(tx, tx_extra);
+}
+
+void
+MultiAccountOutputScanner::scan(
+        transaction const& tx,
+        ParsedTxExtra const& _tx_extra)
+{
+    // account independent part. done only once
+    tx_outputs.set(tx, _tx_extra);
+
+    // now each account checks the extracted outputs
+    for (auto& identifier: identifiers)
+    {
+        identifier.reset();
+        identifier.identify(tx_outputs);
+    }
+}
+
+}
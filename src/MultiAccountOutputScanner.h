@@ -0,0 +1,93 @@
+#pragma once
+
+#include "UniversalIdentifier.hpp"
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * Identifies outputs of many accounts in a given tx.
+ *
+ * Everything that does not depend on account's viewkey
+ * (parsing of tx extra, getting outputs' public keys 
+ * and decompressing them, loading RingCT fields) 
+ * is done only once per tx. Then each account
+ * only does its own key derivation and checks
+ * the already extracted outputs.
+ *
+ * Example:
+ *
+ *  MultiAccountOutputScanner scanner {accounts};
+ *
+ *  for (auto const& tx: txs)
+ *  {
+ *      scanner.scan(tx);
+ *
+ *      for (size_t i = 0; i < scanner.size(); ++i)
+ *          if (!scanner.get(i).empty()) 
+ *              // i-th account has outputs in the tx
+ *  }
+ */
+class MultiAccountOutputScanner
+{
+public:
+
+    MultiAccountOutputScanner() = default;
+
+    explicit MultiAccountOutputScanner(
+            vector<Account*> const& accounts);
+
+    /**
+     * Add account to be scanned. If the account is
+     * PrimaryAccount, its subaddresses are going
+     * to be checked as well.
+     */
+    void
+    add(Account* acc);
+
+    void
+    add(address_parse_info const* address,
+        secret_key const* viewkey);
+
+    /**
+     * Identify outputs of all accounts in the tx.
+     * Results of previous scan are cleared.
+     */
+    void
+    scan(transaction const& tx);
+
+    void
+    scan(transaction const& tx, ParsedTxExtra const& tx_extra);
+
+    // outputs identified for account of the given
+    // number, i.e., in order the accounts were added
+    inline auto const&
+    get(size_t account_no) const
+    {
+        return identifiers.at(account_no).get();
+    }
+
+    inline auto
+    get_total(size_t account_no) const
+    {
+        return identifiers.at(account_no).get_total();
+    }
+
+    inline auto
+    get_view_tag_rejected(size_t account_no) const
+    {
+        return identifiers.at(account_no).get_view_tag_rejected();
+    }
+
+    inline auto 
+    size() const {return identifiers.size();}
+
+private:
+    vector<Output> identifiers;
+    ParsedTxExtra tx_extra;
+    TxOutputs tx_outputs;
+};
+
+}
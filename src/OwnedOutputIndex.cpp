@@ -0,0 +1,102 @@
+#include "OwnedOutputIndex.h"
+
+namespace xmreg
+{
+
+constexpr uint64_t OwnedOutputIndex::UNKNOWN_GLOBAL_IDX;
+
+void
+OwnedOutputIndex::add(Output::info const& out, 
+                      uint64_t global_idx,
+                      uint64_t ring_amount)
+{
+    auto inserted = outputs.insert({out.pub_key, 
+                        info {out.pub_key, out.amount, ring_amount,
+                              global_idx, out.idx_in_tx,
+                              out.subaddr_idx, out.derivation}});
+
+    // in rare cases, different outputs can have
+    // same public keys. we keep the first one.
+    if (!inserted.second)
+        return;
+
+    amounts.insert({out.pub_key, out.amount});
+
+    if (global_idx != UNKNOWN_GLOBAL_IDX)
+    {
+        outputs_by_global_idx.insert({{ring_amount, global_idx}, 
+                                      &inserted.first->second});
+    }
+}
+
+void
+OwnedOutputIndex::add(vector<Output::info> const& outs,
+                      vector<uint64_t> const& global_indices,
+                      size_t tx_version)
+{
+    for (auto const& out: outs)
+    {
+        auto global_idx = out.idx_in_tx < global_indices.size()
+                            ? global_indices[out.idx_in_tx]
+                            : UNKNOWN_GLOBAL_IDX;
+
+        // for txs before ringct, amounts are in plain
+        // sight, so same as the decoded ones
+        add(out, global_idx, tx_version > 1 ? 0 : out.amount);
+    }
+}
+
+bool
+OwnedOutputIndex::remove(public_key const& out_pub_key)
+{
+    auto it = outputs.find(out_pub_key);
+
+    if (it == outputs.end())
+        return false;
+
+    auto const& out = it->second;
+
+    auto global_it = outputs_by_global_idx.find(
+                        {out.ring_amount, out.global_idx});
+
+    if (global_it != outputs_by_global_idx.end() 
+            && global_it->second == &out)
+        outputs_by_global_idx.erase(global_it);
+
+    amounts.erase(out_pub_key);
+    outputs.erase(it);
+
+    return true;
+}
+
+OwnedOutputIndex::info const*
+OwnedOutputIndex::find(public_key const& out_pub_key) const
+{
+    auto it = outputs.find(out_pub_key);
+
+    if (it == outputs.end())
+        return nullptr;
+
+    return &it->second;
+}
+
+OwnedOutputIndex::info const*
+OwnedOutputIndex::find(uint64_t ring_amount, uint64_t global_idx) const
+{
+    auto it = outputs_by_global_idx.find({ring_amount, global_idx});
+
+    if (it == outputs_by_global_idx.end())
+        return nullptr;
+
+    return it->second;
+}
+
+void
+OwnedOutputIndex::clear()
+{
+    amounts.clear();
+    outputs.clear();
+    outputs_by_global_idx.clear();
+}
+
+}
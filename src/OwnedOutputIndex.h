@@ -0,0 +1,137 @@
+#pragma once
+
+#include "UniversalIdentifier.hpp"
+
+#include <unordered_map>
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * Index of outputs of an account, found when
+ * scanning blockchain in order.
+ *
+ * Since we know our outputs before they are spent,
+ * guessing our inputs only requires checking
+ * if a ring member is in the index. Outputs are
+ * indexed by their amounts and global indices, same
+ * as ring members are given in inputs, so that ring 
+ * members don't need to be read from lmdb at all:
+ *
+ *  OwnedOutputIndex owned_outputs;
+ *
+ *  // for each tx in blockchain order
+ *  auto identifier = make_identifier(tx,
+ *        make_unique<Output>(acc),
+ *        make_unique<GuessInput>(acc, &mcore, &owned_outputs));
+ *  identifier.identify();
+ *
+ *  owned_outputs.add(identifier.get<Output>()->get(), 
+ *                    mcore.get_tx_amount_output_indices(tx_id),
+ *                    tx.version);
+ *
+ * The index is not thread-safe.
+ */
+class OwnedOutputIndex
+{
+public:
+
+    static constexpr uint64_t UNKNOWN_GLOBAL_IDX {UINT64_MAX};
+
+    struct info
+    {
+        public_key pub_key;
+        uint64_t amount;
+
+        // amount under which the output is indexed
+        // in blockchain, i.e., 0 for ringct outputs
+        uint64_t ring_amount;
+
+        uint64_t global_idx;
+        uint64_t idx_in_tx;
+        subaddress_index subaddr_idx;
+        key_derivation derivation;
+    };
+
+    /**
+     * Adds output identified by Output identifier.
+     * Outputs without global_idx can be found only
+     * by their public keys.
+     */
+    void
+    add(Output::info const& out,
+        uint64_t global_idx = UNKNOWN_GLOBAL_IDX,
+        uint64_t ring_amount = 0);
+
+    /**
+     * Adds all outputs identified in a tx. global_indices
+     * are amount output indices of all outputs in the tx,
+     * as returned by MicroCore::get_tx_amount_output_indices.
+     * Outputs of txs of version 2 and above are indexed
+     * under amount 0.
+     */
+    void
+    add(vector<Output::info> const& outs,
+        vector<uint64_t> const& global_indices = {},
+        size_t tx_version = 2);
+
+    /**
+     * Removes output, e.g., when its block
+     * was removed due to reorganization
+     */
+    bool
+    remove(public_key const& out_pub_key);
+
+    info const*
+    find(public_key const& out_pub_key) const;
+
+    /**
+     * Output with the given amount and global index,
+     * i.e., as given by absolute offsets of a ring.
+     * Does not allocate, as its called for each 
+     * ring member.
+     */
+    info const*
+    find(uint64_t ring_amount, uint64_t global_idx) const;
+
+    /**
+     * Our outputs with their amounts, as required
+     * by Input and GuessInput identifiers
+     */
+    inline Input::known_outputs_t const*
+    known_outputs() const {return &amounts;}
+
+    inline auto size() const {return outputs.size();}
+
+    void
+    clear();
+
+private:
+
+    // kept separately, so that Input
+    // identifiers can use it directly
+    Input::known_outputs_t amounts;
+
+    unordered_map<public_key, info> outputs;
+
+    using output_id_t = pair<uint64_t, uint64_t>;
+
+    struct output_id_hash
+    {
+        size_t
+        operator()(output_id_t const& id) const
+        {
+            return std::hash<uint64_t>()(id.first) * 31
+                    ^ std::hash<uint64_t>()(id.second);
+        }
+    };
+
+    // points to elements of outputs, which
+    // stay at same addresses when rehashed
+    unordered_map<output_id_t, info const*, output_id_hash> 
+        outputs_by_global_idx;
+};
+
+}
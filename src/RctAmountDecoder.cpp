@@ -0,0 +1,115 @@
+#include "RctAmountDecoder.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace xmreg
+{
+
+bool
+decode_rct_amount(rct::rctSig const& rv,
+                  rct::key const& shared_secret,
+                  size_t i,
+                  uint64_t& amount,
+                  rct::key& mask)
+{
+    bool short_amount;
+
+    switch (rv.type)
+    {
+        case rct::RCTTypeFull:
+        case rct::RCTTypeSimple:
+        case rct::RCTTypeBulletproof:
+            short_amount = false;
+            break;
+        case rct::RCTTypeBulletproof2:
+        case rct::RCTTypeCLSAG:
+        case rct::RCTTypeBulletproofPlus:
+            short_amount = true;
+            break;
+        default:
+            cerr << "Unsupported rct type: " << rv.type << '\n';
+            return false;
+    }
+
+    if (i >= rv.ecdhInfo.size() || i >= rv.outPk.size())
+        return false;
+
+    // ecdhDecode works on a copy, as it
+    // decodes the tuple in place
+    auto ecdh_info = rv.ecdhInfo[i];
+
+    rct::ecdhDecode(ecdh_info, shared_secret, short_amount);
+
+    amount = rct::h2d(ecdh_info.amount);
+    mask = ecdh_info.mask;
+
+    return true;
+}
+
+bool
+verify_rct_commitment(rct::key const& commitment,
+                      uint64_t amount,
+                      rct::key const& mask)
+{
+    // same check as in rct::decodeRctSimple
+    rct::key expected_commitment;
+
+    rct::addKeys2(expected_commitment, mask, rct::d2h(amount), rct::H);
+
+    return rct::equalKeys(commitment, expected_commitment);
+}
+
+void
+CommitmentVerifier::add(public_key const& out_pub_key,
+                        rct::key const& commitment,
+                        uint64_t amount,
+                        rct::key const& mask)
+{
+    outputs.push_back({out_pub_key, commitment, amount, mask});
+}
+
+vector<CommitmentVerifier::output>
+CommitmentVerifier::verify(size_t no_of_threads) const
+{
+    vector<char> valid(outputs.size(), false);
+
+    std::atomic<size_t> next_output {0};
+
+    // each thread writes only to elements of
+    // valid for outputs it took
+    auto worker = [&]()
+    {
+        for (size_t i; (i = next_output++) < outputs.size();)
+        {
+            auto const& out = outputs[i];
+
+            valid[i] = verify_rct_commitment(out.commitment,
+                                             out.amount, out.mask);
+        }
+    };
+
+    no_of_threads = std::min(std::max<size_t>(no_of_threads, 1),
+                             std::max<size_t>(outputs.size(), 1));
+
+    vector<std::thread> threads;
+
+    // calling thread is also one of the workers
+    for (size_t i = 1; i < no_of_threads; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (auto& t: threads)
+        t.join();
+
+    vector<output> failed;
+
+    for (size_t i = 0; i < outputs.size(); ++i)
+        if (!valid[i])
+            failed.push_back(outputs[i]);
+
+    return failed;
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "monero_headers.h"
+
+#include <thread>
+#include <vector>
+
+namespace xmreg
+{
+
+using namespace cryptonote;
+using namespace crypto;
+using namespace std;
+
+/**
+ * Decodes amount and mask of ringct output i from its
+ * ecdhInfo, using shared secret of the output, i.e.,
+ * derivation_to_scalar(derivation, i).
+ *
+ * Unlike rct::decodeRctSimple and rct::decodeRct, it does
+ * not check if the decoded amount and mask match the
+ * output's commitment. Use verify_rct_commitment or
+ * CommitmentVerifier for that.
+ *
+ * Returns false if rv does not have the output or
+ * its rct type is not supported.
+ */
+bool
+decode_rct_amount(rct::rctSig const& rv,
+                  rct::key const& shared_secret,
+                  size_t i,
+                  uint64_t& amount,
+                  rct::key& mask);
+
+/**
+ * Checks if commitment is mask*G + amount*H
+ */
+bool
+verify_rct_commitment(rct::key const& commitment,
+                      uint64_t amount,
+                      rct::key const& mask);
+
+/**
+ * Deferred verification of commitments of decoded
+ * outputs.
+ *
+ * Checking a commitment costs more than decoding its
+ * amount. An Output identifier given this verifier only
+ * decodes amounts of our outputs and adds them here,
+ * so that commitments of all outputs found in, e.g., a
+ * whole block are verified at once, possibly in other
+ * threads than the one which is scanning:
+ *
+ *   CommitmentVerifier verifier;
+ *
+ *   output_identifier->set_commitment_verifier(&verifier);
+ *
+ *   for (auto const& tx: block_txs)
+ *       identifier.identify(tx);
+ *
+ *   for (auto const& failed: verifier.verify())
+ *       // failed.out_pub_key is not a valid output
+ *
+ *   verifier.clear();
+ *
+ * Until verified, amounts of outputs are not to be
+ * trusted, as they could be decoded with a wrong mask.
+ *
+ * Outputs are added in a single thread. verify()
+ * must not be called at the same time.
+ */
+class CommitmentVerifier
+{
+public:
+
+    struct output
+    {
+        public_key out_pub_key;
+        rct::key commitment;
+        uint64_t amount;
+        rct::key mask;
+    };
+
+    void
+    add(public_key const& out_pub_key,
+        rct::key const& commitment,
+        uint64_t amount,
+        rct::key const& mask);
+
+    /**
+     * Verifies all added outputs using no_of_threads.
+     * Returns outputs whose commitments don't match.
+     */
+    vector<output>
+    verify(size_t no_of_threads = 1) const;
+
+    inline void clear() {outputs.clear();}
+
+    inline auto size() const {return outputs.size();}
+
+    inline bool empty() const {return outputs.empty();}
+
+private:
+
+    vector<output> outputs;
+};
+
+}
@@ -0,0 +1,54 @@
+#include "ScanArena.h"
+
+#include <algorithm>
+
+namespace xmreg
+{
+
+ScanArena::ScanArena(size_t _block_size)
+    : block_size {std::max<size_t>(_block_size, 1)}
+{}
+
+void*
+ScanArena::allocate(size_t size, size_t alignment)
+{
+    for (; current_block < blocks.size(); ++current_block, offset = 0)
+    {
+        auto& b = blocks[current_block];
+
+        void* ptr = b.data.get() + offset;
+        size_t space = b.size - offset;
+
+        if (std::align(alignment, size, ptr, space))
+        {
+            offset = b.size - space + size;
+            used += size;
+            return ptr;
+        }
+    }
+
+    // none of blocks has enough free space, so new one is
+    // needed. it is at least big enough for the given size
+    size_t new_block_size = std::max(block_size, size + alignment);
+
+    blocks.push_back({unique_ptr<unsigned char[]>(
+                            new unsigned char[new_block_size]),
+                      new_block_size});
+
+    total_size += new_block_size;
+
+    current_block = blocks.size() - 1;
+    offset = 0;
+
+    return allocate(size, alignment);
+}
+
+void
+ScanArena::release()
+{
+    current_block = 0;
+    offset = 0;
+    used = 0;
+}
+
+}
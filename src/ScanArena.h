@@ -0,0 +1,144 @@
+#pragma once
+
+#include "span.h"
+
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace xmreg
+{
+
+using namespace std;
+
+/**
+ * Monotonic arena for results of a block scan.
+ *
+ * Identifiers keep results of the current tx only, and
+ * their get() returns a reference to them. Results which
+ * are to be kept for the whole block, until it is
+ * persisted, are copied into the arena, with a single
+ * memcpy per tx and no allocations of their own:
+ *
+ *   ScanArena arena;
+ *
+ *   vector<epee::span<Output::info const>> block_outputs;
+ *
+ *   for (auto const& blk: blocks)
+ *   {
+ *       for (auto const& tx: blk_txs)
+ *       {
+ *           identifier.identify(tx);
+ *           block_outputs.push_back(
+ *               arena.copy(identifier.get<Output>()->get()));
+ *       }
+ *
+ *       // persist block_outputs
+ *
+ *       block_outputs.clear();
+ *       arena.release();
+ *   }
+ *
+ * release() frees all results at once, but keeps the
+ * memory, so after first blocks the arena does
+ * not allocate anymore. Spans given by the arena are
+ * valid until release() is called.
+ *
+ * Only trivially copyable types, such as Output::info
+ * and Input::info, can be put into the arena, as their
+ * destructors are never called.
+ *
+ * The arena is not thread-safe. Each thread scanning
+ * blocks should have its own one.
+ */
+class ScanArena
+{
+public:
+
+    explicit ScanArena(size_t _block_size = 64 * 1024);
+
+    ScanArena(ScanArena const&) = delete;
+    ScanArena& operator=(ScanArena const&) = delete;
+
+    ScanArena(ScanArena&&) = default;
+    ScanArena& operator=(ScanArena&&) = default;
+
+    /**
+     * Raw memory of the given size and alignment. Blocks
+     * of memory are allocated only if all the ones
+     * the arena already has are used up.
+     */
+    void*
+    allocate(size_t size, size_t alignment);
+
+    /**
+     * Uninitialized memory for n values of T
+     */
+    template <typename T>
+    epee::span<T>
+    allocate(size_t n)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                "Only trivially copyable types can be in ScanArena");
+
+        if (n == 0)
+            return {};
+
+        return {static_cast<T*>(allocate(n * sizeof(T), alignof(T))), n};
+    }
+
+    /**
+     * Copies values into the arena, e.g., outputs
+     * of a tx identified by Output identifier
+     */
+    template <typename T>
+    epee::span<T const>
+    copy(vector<T> const& values)
+    {
+        auto copied = allocate<T>(values.size());
+
+        if (!values.empty())
+            std::memcpy(copied.data(), values.data(),
+                        values.size() * sizeof(T));
+
+        return {copied.data(), copied.size()};
+    }
+
+    /**
+     * Frees all values in the arena at once.
+     * Its memory is kept for reuse.
+     */
+    void
+    release();
+
+    // bytes given by the arena since last release
+    inline auto size() const {return used;}
+
+    // bytes of memory held by the arena
+    inline auto capacity() const {return total_size;}
+
+    inline auto no_of_blocks() const {return blocks.size();}
+
+private:
+
+    struct memory_block
+    {
+        unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    size_t block_size;
+
+    vector<memory_block> blocks;
+
+    // block from which memory is given now
+    // and offset of its free part
+    size_t current_block {0};
+    size_t offset {0};
+
+    size_t used {0};
+    size_t total_size {0};
+};
+
+}
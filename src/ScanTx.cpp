@@ -0,0 +1,40 @@
+#include "ScanTx.h"
+
+namespace xmreg
+{
+
+ScanTx::ScanTx(blobdata _blob)
+    : blob {std::move(_blob)}
+{}
+
+void
+ScanTx::set_blob(blobdata _blob)
+{
+    blob = std::move(_blob);
+    reset();
+}
+
+void
+ScanTx::set_blob_view(blobdata_ref _blob_view)
+{
+    blob_view = _blob_view;
+    use_blob_view = true;
+    parsed = false;
+}
+
+transaction const*
+ScanTx::get() const
+{
+    if (!parsed)
+    {
+        // parses only the prefix and ringct base.
+        // rest of the blob, if its there, is ignored
+        valid = parse_and_validate_tx_base_from_blob(
+                    use_blob_view ? blob_view : blobdata_ref {blob}, tx);
+        parsed = true;
+    }
+
+    return valid ? &tx : nullptr;
+}
+
+}
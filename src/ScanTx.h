@@ -0,0 +1,103 @@
+#pragma once
+
+#include "monero_headers.h"
+
+namespace xmreg
+{
+
+using namespace cryptonote;
+using namespace std;
+
+/**
+ * Tx blob which is parsed only as much as needed
+ * for scanning, and only when it is first used.
+ *
+ * Identifiers use only the tx prefix (inputs, outputs,
+ * extra) and ringct base fields (type, fee, ecdhInfo,
+ * outPk). Bulletproofs and ring signatures, which are
+ * the largest part of a tx, are not parsed at all. The
+ * blob can be a full or a pruned tx.
+ *
+ *   ScanTx stx;
+ *
+ *   for (auto const& tx_hash: tx_hashes)
+ *   {
+ *       mcore.get_pruned_tx_blob(tx_hash, stx.get_blob());
+ *       stx.reset();
+ *       identifier.identify(stx);
+ *   }
+ *
+ * Reusing the same ScanTx for many txs reuses its blob
+ * and transaction, so that their buffers are not
+ * allocated for each tx again. Blobs read for many 
+ * txs at once, e.g., with MicroCore::get_pruned_tx_blobs, 
+ * can be parsed in place with set_blob_view.
+ *
+ * ScanTx is not thread-safe, as it is parsed in get().
+ */
+class ScanTx
+{
+public:
+
+    ScanTx() = default;
+
+    explicit ScanTx(blobdata _blob);
+
+    /**
+     * Tx with its prefix and ringct base fields.
+     * Its prunable part is always empty.
+     *
+     * Returns nullptr if the blob can't be parsed.
+     */
+    transaction const*
+    get() const;
+
+    /**
+     * Blob to be filled with next tx.
+     * reset() must be called after its changed.
+     */
+    inline blobdata& get_blob() {return blob;}
+
+    inline blobdata const& get_blob() const {return blob;}
+
+    /**
+     * Sets new blob. The previous tx is dropped.
+     */
+    void
+    set_blob(blobdata _blob);
+
+    /**
+     * Uses blob which is not owned by the ScanTx, e.g.,
+     * one of many blobs read for a whole block, so
+     * that it does not need to be copied. The blob must
+     * not change while the ScanTx is used.
+     */
+    void
+    set_blob_view(blobdata_ref _blob_view);
+
+    /**
+     * Drops parsed tx, so that next get()
+     * parses the current blob of the ScanTx
+     */
+    inline void reset()
+    {
+        use_blob_view = false;
+        parsed = false;
+    }
+
+private:
+
+    blobdata blob;
+
+    // not owned blob, parsed instead of the above 
+    // one if use_blob_view is set
+    blobdata_ref blob_view;
+    bool use_blob_view {false};
+
+    // parsed lazily in get()
+    mutable transaction tx;
+    mutable bool parsed {false};
+    mutable bool valid {false};
+};
+
+}
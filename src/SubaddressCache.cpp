@@ -0,0 +1,351 @@
+#include "SubaddressCache.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+extern "C" {
+#include "crypto/hmac-keccak.h"
+}
+
+namespace xmreg
+{
+
+namespace bf = boost::filesystem;
+namespace bip = boost::interprocess;
+
+namespace
+{
+
+constexpr char CACHE_MAGIC[8] {'x', 'm', 'r', 's', 'u', 'b', 'c', 'h'};
+constexpr uint32_t CACHE_VERSION {2};
+
+// number of entries generated again
+// to check a loaded file
+constexpr uint64_t NO_OF_CHECKED_ENTRIES {4};
+
+struct cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t next_acc_id;
+    uint64_t no_of_entries;
+    public_key psk;
+    public_key pvk;
+
+    // hmac of the header, up to the mac, 
+    // and of all entries
+    crypto::hash mac;
+};
+
+struct cache_entry
+{
+    public_key key;
+    uint32_t major;
+    uint32_t minor;
+};
+
+// files are read and written as they are in memory,
+// so these must not have any padding
+static_assert(sizeof(cache_header) == 120, "cache_header is padded");
+static_assert(sizeof(cache_entry) == 40, "cache_entry is padded");
+
+std::mutex default_cache_mutex;
+shared_ptr<SubaddressCache const> default_cache;
+
+// all subaddresses of account ids lower than 
+// next_acc_id, without 0/0 which is the primary address
+uint64_t
+no_of_entries_for(uint32_t next_acc_id, uint32_t no_of_minor)
+{
+    if (next_acc_id == 0)
+        return 0;
+
+    return uint64_t {next_acc_id} * no_of_minor - 1;
+}
+
+bool
+is_cached_index(uint32_t major, uint32_t minor,
+                uint32_t next_acc_id, uint32_t no_of_minor)
+{
+    return major < next_acc_id 
+        && minor < no_of_minor
+        && !(major == 0 && minor == 0);
+}
+
+crypto::hash
+calc_mac(secret_key const& viewkey,
+         cache_header const& header,
+         char const* entries, size_t entries_size)
+{
+    hmac_keccak_state state;
+
+    hmac_keccak_init(&state, 
+            reinterpret_cast<uint8_t const*>(&viewkey), 
+            sizeof(viewkey));
+
+    hmac_keccak_update(&state, 
+            reinterpret_cast<uint8_t const*>(&header),
+            offsetof(cache_header, mac));
+
+    hmac_keccak_update(&state, 
+            reinterpret_cast<uint8_t const*>(entries),
+            entries_size);
+
+    crypto::hash mac;
+
+    hmac_keccak_finish(&state, reinterpret_cast<uint8_t*>(&mac));
+
+    return mac;
+}
+
+/**
+ * Checks mapped cache file and adds its entries
+ * into subaddresses, only if the whole file is valid
+ */
+bool
+read_cache_file(char const* data, size_t size,
+                account_keys const& keys,
+                uint32_t no_of_minor,
+                SubaddressMap& subaddresses,
+                uint32_t& next_acc_id)
+{
+    if (size < sizeof(cache_header))
+        return false;
+
+    cache_header header;
+    memcpy(&header, data, sizeof(header));
+
+    auto entries = data + sizeof(header);
+    auto entries_size = size - sizeof(header);
+
+    auto const& address = keys.m_account_address;
+
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+            || header.version != CACHE_VERSION
+            || header.psk != address.m_spend_public_key
+            || header.pvk != address.m_view_public_key
+            || entries_size % sizeof(cache_entry) != 0
+            || entries_size / sizeof(cache_entry) != header.no_of_entries
+            || header.no_of_entries 
+                != no_of_entries_for(header.next_acc_id, no_of_minor))
+    {
+        return false;
+    }
+
+    if (calc_mac(keys.m_view_secret_key, header, 
+                 entries, entries_size) != header.mac)
+        return false;
+
+    auto get_entry = [&](uint64_t i)
+    {
+        cache_entry entry;
+        memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+        return entry;
+    };
+
+    for (uint64_t i = 0; i < header.no_of_entries; ++i)
+    {
+        auto entry = get_entry(i);
+
+        if (!is_cached_index(entry.major, entry.minor,
+                             header.next_acc_id, no_of_minor))
+            return false;
+    }
+
+    // few entries, spread over the file, are 
+    // generated again and must match the cached ones
+    auto& device = hw::get_device("default");
+
+    auto no_of_checked = std::min(NO_OF_CHECKED_ENTRIES, 
+                                  header.no_of_entries);
+
+    for (uint64_t i = 0; i < no_of_checked; ++i)
+    {
+        auto entry = get_entry(no_of_checked > 1 
+                ? i * (header.no_of_entries - 1) / (no_of_checked - 1)
+                : 0);
+
+        if (device.get_subaddress_spend_public_key(
+                    keys, {entry.major, entry.minor}) != entry.key)
+            return false;
+    }
+
+    subaddresses.reserve(subaddresses.size() + header.no_of_entries);
+
+    for (uint64_t i = 0; i < header.no_of_entries; ++i)
+    {
+        auto entry = get_entry(i);
+        subaddresses.insert({entry.key, {entry.major, entry.minor}});
+    }
+
+    next_acc_id = header.next_acc_id;
+
+    return true;
+}
+
+}
+
+SubaddressCache::SubaddressCache(string _dir)
+    : dir {std::move(_dir)}
+{}
+
+string
+SubaddressCache::file_path(public_key const& psk,
+                           public_key const& pvk) const
+{
+    char keys[2 * sizeof(public_key)];
+
+    memcpy(keys, &psk, sizeof(public_key));
+    memcpy(keys + sizeof(public_key), &pvk, sizeof(public_key));
+
+    auto keys_hash = cn_fast_hash(keys, sizeof(keys));
+
+    return (bf::path {dir}
+            / (epee::string_tools::pod_to_hex(keys_hash) + ".subaddr"))
+                .string();
+}
+
+bool
+SubaddressCache::load(account_keys const& keys,
+                      uint32_t no_of_minor,
+                      SubaddressMap& subaddresses,
+                      uint32_t& next_acc_id) const
+{
+    auto path = file_path(keys.m_account_address.m_spend_public_key,
+                          keys.m_account_address.m_view_public_key);
+
+    boost::system::error_code ec;
+
+    if (!bf::is_regular_file(path, ec))
+        return false;
+
+    bool loaded {false};
+
+    try
+    {
+        bip::file_mapping file {path.c_str(), bip::read_only};
+        bip::mapped_region region {file, bip::read_only};
+
+        loaded = read_cache_file(
+                    static_cast<char const*>(region.get_address()),
+                    region.get_size(), keys, no_of_minor,
+                    subaddresses, next_acc_id);
+    }
+    catch (bip::interprocess_exception const&)
+    {
+        loaded = false;
+    }
+
+    // truncated, stale or tampered file. its removed, 
+    // so that subaddresses are generated and saved again
+    if (!loaded)
+        bf::remove(path, ec);
+
+    return loaded;
+}
+
+bool
+SubaddressCache::save(account_keys const& keys,
+                      uint32_t no_of_minor,
+                      SubaddressMap const& subaddresses,
+                      uint32_t next_acc_id) const
+{
+    auto const no_of_entries = no_of_entries_for(next_acc_id, no_of_minor);
+
+    vector<cache_entry> entries;
+    entries.reserve(no_of_entries);
+
+    // subaddresses added one by one, e.g., with 
+    // add_subaddress_index, are not cached
+    for (auto const& kv: subaddresses)
+    {
+        if (is_cached_index(kv.second.major, kv.second.minor,
+                            next_acc_id, no_of_minor))
+        {
+            entries.push_back({kv.first, 
+                               kv.second.major, kv.second.minor});
+        }
+    }
+
+    if (entries.size() != no_of_entries)
+        return false;
+
+    boost::system::error_code ec;
+
+    bf::create_directories(dir, ec);
+
+    if (ec)
+        return false;
+
+    auto const& address = keys.m_account_address;
+
+    auto path = file_path(address.m_spend_public_key,
+                          address.m_view_public_key);
+
+    // other processes can save the same account
+    // at the same time, so each uses its own file
+    auto tmp_path = path + bf::unique_path(".%%%%-%%%%.tmp", ec).string();
+
+    if (ec)
+        return false;
+
+    cache_header header;
+
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.next_acc_id = next_acc_id;
+    header.no_of_entries = entries.size();
+    header.psk = address.m_spend_public_key;
+    header.pvk = address.m_view_public_key;
+    header.mac = calc_mac(keys.m_view_secret_key, header,
+                          reinterpret_cast<char const*>(entries.data()),
+                          entries.size() * sizeof(cache_entry));
+
+    {
+        std::ofstream out {tmp_path, std::ios::binary | std::ios::trunc};
+
+        out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        out.write(reinterpret_cast<char const*>(entries.data()),
+                  entries.size() * sizeof(cache_entry));
+
+        if (!out)
+        {
+            out.close();
+            bf::remove(tmp_path, ec);
+            return false;
+        }
+    }
+
+    bf::rename(tmp_path, path, ec);
+
+    if (ec)
+    {
+        bf::remove(tmp_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+void
+SubaddressCache::set_default(shared_ptr<SubaddressCache const> cache)
+{
+    std::lock_guard<std::mutex> lk {default_cache_mutex};
+    default_cache = std::move(cache);
+}
+
+shared_ptr<SubaddressCache const>
+SubaddressCache::get_default()
+{
+    std::lock_guard<std::mutex> lk {default_cache_mutex};
+    return default_cache;
+}
+
+}
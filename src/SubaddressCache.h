@@ -0,0 +1,108 @@
+#pragma once
+
+#include "monero_headers.h"
+#include "SubaddressMap.h"
+
+#include <memory>
+#include <string>
+
+namespace xmreg
+{
+
+using namespace cryptonote;
+using namespace crypto;
+using namespace std;
+
+/**
+ * On-disk cache of subaddresses' public spend keys.
+ *
+ * Populating 50 x 200 subaddresses takes 10'000 curve
+ * operations for each account, every time the account
+ * is created. The cache stores already generated
+ * subaddresses of an account in a file, so that they
+ * are loaded back in time proportional to the file size,
+ * without any curve operations.
+ *
+ * Each account has its own file, named after a hash of
+ * its public spend and view keys. The file has a header
+ * with the keys and next account id to populate,
+ * followed by raw entries of the SubaddressMap, i.e., 
+ * all subaddresses of accounts up to the next account id,
+ * without the primary address itself. Files are memory 
+ * mapped when loaded, and written into temporary files 
+ * that are renamed when complete, so that readers never 
+ * see partially written files.
+ *
+ * Files are authenticated with HMAC keyed by the
+ * account's view key, and few of their entries are
+ * generated again when loaded, so that a file written
+ * by someone else, or stale one, is not used. Files
+ * which are not valid are removed, so that the
+ * subaddresses are generated and saved again.
+ *
+ * The files are not encrypted. Although they contain
+ * only public keys, these link subaddresses to their
+ * primary address, so the cache directory should not be
+ * readable by others.
+ *
+ * The cache is disabled unless the default one is set
+ * with SubaddressCache::set_default.
+ */
+class SubaddressCache
+{
+public:
+
+    explicit SubaddressCache(string _dir);
+
+    /**
+     * Loads cached subaddresses of the account with
+     * given keys into the subaddresses map, and sets 
+     * next_acc_id to the first account id that is 
+     * not cached. Each account id has no_of_minor 
+     * subaddresses.
+     *
+     * Returns false, and changes nothing, if there
+     * is no cache file for the account or it is not valid.
+     */
+    bool
+    load(account_keys const& keys,
+         uint32_t no_of_minor,
+         SubaddressMap& subaddresses,
+         uint32_t& next_acc_id) const;
+
+    /**
+     * Replaces the account's cache file with subaddresses
+     * of account ids lower than next_acc_id from the given 
+     * subaddresses map.
+     *
+     * Returns false if the file can't be written, or
+     * the map does not have all these subaddresses.
+     */
+    bool
+    save(account_keys const& keys,
+         uint32_t no_of_minor,
+         SubaddressMap const& subaddresses,
+         uint32_t next_acc_id) const;
+
+    string
+    file_path(public_key const& psk,
+              public_key const& pvk) const;
+
+    inline auto const& get_dir() const {return dir;}
+
+    /**
+     * Cache used by PrimaryAccounts. nullptr
+     * disables caching, which is the default.
+     */
+    static void
+    set_default(shared_ptr<SubaddressCache const> cache);
+
+    static shared_ptr<SubaddressCache const>
+    get_default();
+
+private:
+
+    string dir;
+};
+
+}
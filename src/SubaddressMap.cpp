@@ -0,0 +1,137 @@
+#include "SubaddressMap.h"
+
+namespace xmreg
+{
+
+constexpr size_t SubaddressMap::MIN_NO_OF_SLOTS;
+
+void
+SubaddressMap::reserve(size_t n)
+{
+    entries.reserve(n);
+
+    if (slots_for(n) > slots.size())
+        rehash(slots_for(n));
+}
+
+size_t
+SubaddressMap::find_slot(public_key const& key) const
+{
+    size_t mask = slots.size() - 1;
+
+    size_t i = key_prefix(key) & mask;
+
+    uint32_t tag = key_tag(key);
+
+    // table is never full, so this always
+    // ends on the key or on an empty slot
+    while (slots[i].entry_no != 0)
+    {
+        if (slots[i].tag == tag
+                && entries[slots[i].entry_no - 1].first == key)
+        {
+            break;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+pair<SubaddressMap::const_iterator, bool>
+SubaddressMap::insert(value_type const& entry)
+{
+    if (slots_for(entries.size() + 1) > slots.size())
+        rehash(slots_for(entries.size() + 1));
+
+    auto i = find_slot(entry.first);
+
+    if (slots[i].entry_no != 0)
+    {
+        return {entries.cbegin() + (slots[i].entry_no - 1), false};
+    }
+
+    entries.push_back(entry);
+
+    slots[i].tag = key_tag(entry.first);
+    slots[i].entry_no = static_cast<uint32_t>(entries.size());
+
+    return {entries.cend() - 1, true};
+}
+
+SubaddressMap::const_iterator
+SubaddressMap::find(public_key const& key) const
+{
+    if (slots.empty())
+        return end();
+
+    auto i = find_slot(key);
+
+    if (slots[i].entry_no == 0)
+        return end();
+
+    return entries.cbegin() + (slots[i].entry_no - 1);
+}
+
+void
+SubaddressMap::rehash(size_t no_of_slots)
+{
+    size_t new_size {MIN_NO_OF_SLOTS};
+
+    while (new_size < no_of_slots)
+        new_size *= 2;
+
+    if (new_size <= slots.size())
+        return;
+
+    slots.assign(new_size, slot {0, 0});
+
+    size_t mask = new_size - 1;
+
+    for (size_t entry_no = 0; entry_no < entries.size(); ++entry_no)
+    {
+        auto const& key = entries[entry_no].first;
+
+        size_t i = key_prefix(key) & mask;
+
+        while (slots[i].entry_no != 0)
+            i = (i + 1) & mask;
+
+        slots[i].tag = key_tag(key);
+        slots[i].entry_no = static_cast<uint32_t>(entry_no + 1);
+    }
+}
+
+void
+SubaddressMap::clear()
+{
+    entries.clear();
+    std::fill(slots.begin(), slots.end(), slot {0, 0});
+}
+
+size_t
+SubaddressMap::memory_usage() const
+{
+    return entries.capacity() * sizeof(value_type)
+            + slots.capacity() * sizeof(slot);
+}
+
+bool
+SubaddressMap::operator==(SubaddressMap const& other) const
+{
+    if (size() != other.size())
+        return false;
+
+    for (auto const& entry: entries)
+    {
+        auto it = other.find(entry.first);
+
+        if (it == other.end() || !(it->second == entry.second))
+            return false;
+    }
+
+    return true;
+}
+
+}
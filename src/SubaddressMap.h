@@ -0,0 +1,143 @@
+#pragma once
+
+#include "monero_headers.h"
+
+#include <utility>
+#include <vector>
+
+namespace xmreg
+{
+
+using namespace cryptonote;
+using namespace crypto;
+using namespace std;
+
+/**
+ * Map of subaddresses' public spend keys to their indices.
+ *
+ * It replaces unordered_map used before, which allocated 
+ * a node for each of 10'000 subaddresses of each account.
+ * Here, entries are kept next to each other in a vector,
+ * and a flat open-addressing (linear probing) table points
+ * to them. The table is indexed by a prefix of a public
+ * key, and a tag from next bytes of the key is compared 
+ * before the full key is checked. Public keys are 
+ * random enough to be used like that without hashing.
+ *
+ * Only insertions are supported, as subaddresses 
+ * are never removed. Iteration gives entries in 
+ * their insertion order, as pairs of a key and index, 
+ * same as unordered_map did. Iterators are invalidated 
+ * by insertions.
+ */
+class SubaddressMap
+{
+public:
+
+    using key_type = public_key;
+    using mapped_type = subaddress_index;
+    using value_type = pair<public_key, subaddress_index>;
+
+    // entries can't be modified, as that would
+    // break the table
+    using const_iterator = vector<value_type>::const_iterator;
+    using iterator = const_iterator;
+
+    SubaddressMap() = default;
+
+    /**
+     * Allocates table for n entries, so that
+     * it does not need to grow while being populated
+     */
+    void
+    reserve(size_t n);
+
+    /**
+     * Same as unordered_map::insert. If key is already
+     * in the map, its index is not changed.
+     */
+    pair<const_iterator, bool>
+    insert(value_type const& entry);
+
+    const_iterator
+    find(public_key const& key) const;
+
+    inline size_t count(public_key const& key) const
+    {return find(key) != end();}
+
+    inline size_t size() const {return entries.size();}
+    inline bool empty() const {return entries.empty();}
+
+    inline const_iterator begin() const {return entries.cbegin();}
+    inline const_iterator end() const {return entries.cend();}
+    inline const_iterator cbegin() const {return entries.cbegin();}
+    inline const_iterator cend() const {return entries.cend();}
+
+    void
+    clear();
+
+    /**
+     * Bytes allocated by the map
+     */
+    size_t
+    memory_usage() const;
+
+    /**
+     * Maps are equal if they have same entries,
+     * regardless of their order
+     */
+    bool
+    operator==(SubaddressMap const& other) const;
+
+    inline bool
+    operator!=(SubaddressMap const& other) const
+    {return !(*this == other);}
+
+private:
+
+    struct slot
+    {
+        uint32_t tag;
+
+        // position of the entry in entries plus one.
+        // zero means empty slot
+        uint32_t entry_no;
+    };
+
+    static constexpr size_t MIN_NO_OF_SLOTS {16};
+
+    // table is not filled more than 3/4
+    static inline size_t
+    slots_for(size_t no_of_entries)
+    {return no_of_entries + no_of_entries / 3 + 1;}
+
+    static inline uint64_t
+    key_prefix(public_key const& key)
+    {
+        uint64_t prefix;
+        memcpy(&prefix, key.data, sizeof(prefix));
+        return prefix;
+    }
+
+    static inline uint32_t
+    key_tag(public_key const& key)
+    {
+        uint32_t tag;
+        memcpy(&tag, key.data + sizeof(uint64_t), sizeof(tag));
+        return tag;
+    }
+
+    // slot where the key is or where it should be inserted
+    size_t
+    find_slot(public_key const& key) const;
+
+    void
+    rehash(size_t no_of_slots);
+
+    vector<value_type> entries;
+
+    // size is always power of two
+    vector<slot> slots;
+};
+
+}
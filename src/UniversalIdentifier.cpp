@@ -1,4 +1,6 @@
 #include "UniversalIdentifier.hpp"
+#include "MixinTxCache.h"
+#include "OwnedOutputIndex.h"
 
 namespace xmreg
 {
@@ -6,16 +8,9 @@ namespace xmreg
 using  epee::string_tools::pod_to_hex;
 using  epee::string_tools::hex_to_pod;
 
-public_key
-get_tx_pub_key_from_received_outs(transaction const& tx)
+static public_key
+get_tx_pub_key_from_fields(vector<tx_extra_field> const& tx_extra_fields)
 {
-  std::vector<tx_extra_field> tx_extra_fields;
-
-  if(!parse_tx_extra(tx.extra, tx_extra_fields))
-  {
-      // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-  }
-
   // Due to a previous bug, there might be more than one tx pubkey in extra, one being
   // the result of a previously discarded signature.
   // For speed, since scanning for outputs is a slow process, we check whether extra
@@ -48,18 +43,264 @@ get_tx_pub_key_from_received_outs(transaction const& tx)
   return null_pkey;
 }
 
+public_key
+get_tx_pub_key_from_received_outs(transaction const& tx)
+{
+  std::vector<tx_extra_field> tx_extra_fields;
+
+  if(!parse_tx_extra(tx.extra, tx_extra_fields))
+  {
+      // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
+  }
+
+  return get_tx_pub_key_from_fields(tx_extra_fields);
+}
+
+
+void
+ParsedTxExtra::set(transaction const& tx)
+{
+    tx_extra_fields.clear();
+
+    // Extra may only be partially parsed, it's OK if 
+    // tx_extra_fields contains public keys
+    bool parsed_all = parse_tx_extra(tx.extra, tx_extra_fields);
+
+    tx_pub_key = get_tx_pub_key_from_fields(tx_extra_fields);
+
+    // the field is copy assigned into the retained 
+    // additional_pub_keys, reusing its capacity
+    if (find_tx_extra_field_by_type(tx_extra_fields, additional_pub_keys))
+        additional_tx_pub_keys.swap(additional_pub_keys.data);
+    else
+        additional_tx_pub_keys.clear();
+
+    nonce.clear();
+    payment_id = crypto::hash {};
+    payment_id8 = crypto::hash8 {};
+
+    // payment ids are only taken from fully parsed extra
+    if (!parsed_all)
+        return;
+
+    if (!find_tx_extra_field_by_type(tx_extra_fields, extra_nonce))
+        return;
+
+    nonce.swap(extra_nonce.nonce);
+
+    // first check for encrypted id and then for normal one
+    if (!get_encrypted_payment_id_from_tx_extra_nonce(nonce, payment_id8))
+    {
+        get_payment_id_from_tx_extra_nonce(nonce, payment_id);
+    }
+}
+
+
+void
+TxOutputs::set(transaction const& tx, ParsedTxExtra const& tx_extra)
+{
+    is_coinbase = cryptonote::is_coinbase(tx);
+    version = tx.version;
+    rct_signatures = &tx.rct_signatures;
+
+    tx_pub_key = tx_extra.tx_pub_key;
+    additional_tx_pub_keys = &tx_extra.additional_tx_pub_keys;
+
+    // clear, but keep the capacity for next tx
+    outputs.clear();
+    outputs.reserve(tx.vout.size());
+
+    for (auto i = 0u; i < tx.vout.size(); ++i)
+    {
+        // i will act as output indxes in the tx
+
+        output out {};
+
+        out.amount = tx.vout[i].amount;
+        out.idx_in_tx = i;
+
+        auto const& target = tx.vout[i].target;
+
+        if (target.type() == typeid(txout_to_key))
+        {
+            out.key = boost::get<txout_to_key>(target).key;
+        }
+        else if (target.type() == typeid(txout_to_tagged_key))
+        {
+            // since hf 15 outputs have also view tags
+            auto const& txout_key 
+                    = boost::get<txout_to_tagged_key>(target);
+
+            out.key = txout_key.key;
+            out.view_tag = txout_key.view_tag;
+            out.has_view_tag = true;
+        }
+        else
+        {
+            continue;
+        }
+
+        // if the key is not a valid point, there is
+        // no way this output is ours, so skip it.
+        if (ge_frombytes_vartime(&out.key_point,
+                    reinterpret_cast<unsigned char const*>(
+                        &out.key)) != 0)
+        {
+            continue;
+        }
+
+        outputs.push_back(out);
+    }
+}
+
+static inline bool
+view_tag_matches(TxOutputs::output const& out,
+                 key_derivation const& derivation)
+{
+    crypto::view_tag vt;
+
+    derive_view_tag(derivation, out.idx_in_tx, vt);
+
+    return vt.data == out.view_tag.data;
+}
+
+/**
+ * Same as crypto::derive_subaddress_public_key, but 
+ * uses already decompressed output public key
+ */
+static void
+derive_subaddress_spendkey(ge_p3 const& out_key_point,
+                           key_derivation const& derivation,
+                           size_t output_index,
+                           public_key& subaddress_spendkey)
+{
+    ec_scalar scalar;
+    ge_p3 point2;
+    ge_cached point3;
+    ge_p1p1 point4;
+    ge_p2 point5;
+
+    derivation_to_scalar(derivation, output_index, scalar);
+
+    ge_scalarmult_base(&point2,
+            reinterpret_cast<unsigned char const*>(&scalar));
+    ge_p3_to_cached(&point3, &point2);
+    ge_sub(&point4, &out_key_point, &point3);
+    ge_p1p1_to_p2(&point5, &point4);
+    ge_tobytes(reinterpret_cast<unsigned char*>(&subaddress_spendkey),
+               &point5);
+}
+
+bool
+BaseIdentifier::get_derivation(public_key const& pub_key,
+                               key_derivation& derivation) const
+{
+    if (derivation_cache)
+        return derivation_cache->get(pub_key, *get_viewkey(), derivation);
+
+    return generate_key_derivation(pub_key, *get_viewkey(), derivation);
+}
+
+// same as generate_key_image_helper_precomp, but
+// with crypto functions called directly, and
+// without the output's secret key returned.
+// subaddress secret key is computed as in
+// device_default::get_subaddress_secret_key
+bool
+SoftwareCrypto::generate_key_image(hw::device& hwdev,
+                                   account_keys const& keys,
+                                   public_key const& out_key,
+                                   key_derivation const& derivation,
+                                   size_t output_index,
+                                   subaddress_index const& subaddr_idx,
+                                   key_image& key_img)
+{
+    if (keys.m_spend_secret_key == null_skey)
+    {
+        // view only account. as in monero, key image 
+        // is generated with null secret key, so it
+        // does not match any real key image
+        crypto::generate_key_image(out_key, null_skey, key_img);
+        return true;
+    }
+
+    if (!keys.m_multisig_keys.empty())
+    {
+        // multisig keys are rare, so just 
+        // use the device for them
+        return DeviceCrypto::generate_key_image(
+                    hwdev, keys, out_key, derivation,
+                    output_index, subaddr_idx, key_img);
+    }
+
+    secret_key in_secret_key;
+
+    // x = Hs(8aR || i) + b
+    derive_secret_key(derivation, output_index,
+                      keys.m_spend_secret_key, in_secret_key);
+
+    if (!subaddr_idx.is_zero())
+    {
+        // x += Hs("SubAddr" || a || major || minor)
+        char data[sizeof(config::HASH_KEY_SUBADDRESS)
+                  + sizeof(secret_key) + 2 * sizeof(uint32_t)];
+
+        memcpy(data, config::HASH_KEY_SUBADDRESS,
+               sizeof(config::HASH_KEY_SUBADDRESS));
+        memcpy(data + sizeof(config::HASH_KEY_SUBADDRESS),
+               &keys.m_view_secret_key, sizeof(secret_key));
+
+        uint32_t idx = SWAP32LE(subaddr_idx.major);
+        memcpy(data + sizeof(config::HASH_KEY_SUBADDRESS)
+                    + sizeof(secret_key), &idx, sizeof(uint32_t));
+
+        idx = SWAP32LE(subaddr_idx.minor);
+        memcpy(data + sizeof(config::HASH_KEY_SUBADDRESS)
+                    + sizeof(secret_key) + sizeof(uint32_t),
+               &idx, sizeof(uint32_t));
+
+        secret_key subaddr_sk;
+
+        hash_to_scalar(data, sizeof(data), subaddr_sk);
+
+        sc_add(reinterpret_cast<unsigned char*>(&in_secret_key),
+               reinterpret_cast<unsigned char const*>(&in_secret_key),
+               reinterpret_cast<unsigned char const*>(&subaddr_sk));
+    }
+
+    public_key in_public_key;
+
+    if (!secret_key_to_public_key(in_secret_key, in_public_key))
+        return false;
+
+    if (in_public_key != out_key)
+        return false;
+
+    crypto::generate_key_image(in_public_key, in_secret_key, key_img);
+
+    return true;
+}
+
+template <typename CryptoPolicy>
+void
+BasicOutput<CryptoPolicy>::identify(transaction const& tx,
+                                    ParsedTxExtra const& tx_extra)
+{
+    tx_outputs.set(tx, tx_extra);
+
+    identify(tx_outputs);
+}
 
+template <typename CryptoPolicy>
 void
-Output::identify(transaction const& tx,
-                 public_key const& tx_pub_key,
-                 vector<public_key> const& additional_tx_pub_keys)
+BasicOutput<CryptoPolicy>::identify(TxOutputs const& txo)
 {
-    auto tx_is_coinbase = is_coinbase(tx);
+    auto const& tx_pub_key = txo.tx_pub_key;
+    auto const& additional_tx_pub_keys = *txo.additional_tx_pub_keys;
 
     key_derivation derivation;
 
-    if (!generate_key_derivation(tx_pub_key,
-                                 *get_viewkey(), derivation))
+    if (!get_derivation(tx_pub_key, derivation))
     {
         static_assert(sizeof(derivation) == sizeof(rct::key),
                 "Mismatched sizes of key_derivation and rct::key");
@@ -72,9 +313,10 @@ Output::identify(transaction const& tx,
 
     // since introduction of subaddresses, a tx can
     // have extra public keys, thus we need additional
-    // derivations
+    // derivations. the vector is a member, so it 
+    // does not allocate for each tx
 
-    vector<key_derivation> additional_derivations;
+    additional_derivations.clear();
 
     if (!additional_tx_pub_keys.empty())
     {
@@ -82,9 +324,8 @@ Output::identify(transaction const& tx,
 
         for (size_t i = 0; i < additional_tx_pub_keys.size(); ++i)
         {
-            if (!generate_key_derivation(additional_tx_pub_keys[i],
-                                         *get_viewkey(),
-                                         additional_derivations[i]))
+            if (!get_derivation(additional_tx_pub_keys[i],
+                                additional_derivations[i]))
             {
                 static_assert(sizeof(derivation) == sizeof(rct::key),
                         "Mismatched sizes of key_derivation and rct::key");
@@ -115,18 +356,12 @@ Output::identify(transaction const& tx,
     }
 
 
-    for (auto i = 0u; i < tx.vout.size(); ++i)
+    for (auto const& out: txo.outputs)
     {
-        // i will act as output indxes in the tx
+        // i is the output indx in the tx
+        auto const i = out.idx_in_tx;
 
-        if (tx.vout[i].target.type() != typeid(txout_to_key))
-            continue;
-
-        // get tx input key
-        txout_to_key const& txout_key
-                = boost::get<txout_to_key>(tx.vout[i].target);
-
-        uint64_t amount = tx.vout[i].amount;
+        uint64_t amount = out.amount;
 
 		// calculate public spendkey using derivation
 		// and tx output key. If this is our output
@@ -143,11 +378,31 @@ Output::identify(transaction const& tx,
         // we are not using primary addresses directly
         // but instead use a subaddress for searching
         // outputs
-        std::unique_ptr<subaddress_index> subaddr_idx;
+        boost::optional<subaddress_index> subaddr_idx;
+
+        // for outputs with view tags, first check the tags. 
+        // this is just a hash, so it is much cheaper than deriving 
+        // subaddress spendkey. Only 1/256 of outputs which 
+        // are not ours is going to pass this check.
+        auto check_main = true;
+        auto check_additional = i < additional_derivations.size();
 
-        hwdev.derive_subaddress_public_key(
-					txout_key.key, derivation, i, 
-					subaddress_spendkey);
+        if (out.has_view_tag)
+        {
+            check_main = view_tag_matches(out, derivation);
+
+            if (check_additional)
+            {
+                check_additional = view_tag_matches(
+                        out, additional_derivations[i]);
+            }
+
+            if (!check_main && !check_additional)
+            {
+                ++view_tag_rejected;
+                continue;
+            }
+        }
 
         // this derivation is going to be saved 
         // it can be one of addiitnal derivations
@@ -157,8 +412,16 @@ Output::identify(transaction const& tx,
 
 	    bool mine_output {false};
 
-        if (!pacc)
+        if (!check_main)
+        {
+            // view tag does not match, so
+            // only additional derivation can be used
+        }
+        else if (!pacc)
         {
+            derive_subaddress_spendkey(out.key_point, derivation, 
+                                       i, subaddress_spendkey);
+
             // if pacc is not given, we check generated 
             // subaddress_spendkey against the spendkey 
             // of the address for which the Output identifier
@@ -167,6 +430,9 @@ Output::identify(transaction const& tx,
         }
         else
         {
+            derive_subaddress_spendkey(out.key_point, derivation, 
+                                       i, subaddress_spendkey);
+
             // if pacc is given, we are going to use its 
             // subaddress unordered map to check if generated
             // subaddress_spendkey is one of its keys. this is 
@@ -181,13 +447,12 @@ Output::identify(transaction const& tx,
 
         auto with_additional = false;
 
-        if (!mine_output && !additional_tx_pub_keys.empty())
+        if (!mine_output && check_additional)
         {
             // check for output using additional tx public keys
-	    	hwdev.derive_subaddress_public_key(
-						txout_key.key, additional_derivations[i], 
-						i, 
-						subaddress_spendkey);
+            derive_subaddress_spendkey(out.key_point, 
+                                       additional_derivations[i], 
+                                       i, subaddress_spendkey);
 	    
             // do same comparison as above depending of the 
             // avaliabity of the PrimaryAddress Account 
@@ -213,7 +478,7 @@ Output::identify(transaction const& tx,
 
         // if mine output has RingCT, i.e., tx version is 2
         // need to decode its amount. otherwise its zero.
-        if (mine_output && tx.version == 2)
+        if (mine_output && txo.version == 2)
         {
             // initialize with regular amount value
             // for ringct, except coinbase, it will be 0
@@ -221,7 +486,7 @@ Output::identify(transaction const& tx,
 
             // cointbase txs have amounts in plain sight.
             // so use amount from ringct, only for non-coinbase txs
-            if (!tx_is_coinbase)
+            if (!txo.is_coinbase)
             {
                 // for ringct non-coinbase txs, these values are given
                 // with txs.
@@ -233,23 +498,21 @@ Output::identify(transaction const& tx,
                 // to see how we deal with coinbase ringct that are used
                 // as mixins
 
-                rtc_outpk = tx.rct_signatures.outPk[i].mask;
-                rtc_mask = tx.rct_signatures.ecdhInfo[i].mask;
-                rtc_amount = tx.rct_signatures.ecdhInfo[i].amount;
+                rtc_outpk = txo.rct_signatures->outPk[i].mask;
+                rtc_mask = txo.rct_signatures->ecdhInfo[i].mask;
+                rtc_amount = txo.rct_signatures->ecdhInfo[i].amount;
 
-                rct::key mask =  tx.rct_signatures.ecdhInfo[i].mask;
+                rct::key mask =  txo.rct_signatures->ecdhInfo[i].mask;
         
                 derivation_to_save = !with_additional ? derivation
                                              : additional_derivations[i];
 
-                auto r = decode_ringct(tx.rct_signatures,
+                auto r = decode_ringct(*txo.rct_signatures,
                                        derivation_to_save,
                                        i,
                                        mask,
                                        rct_amount_val);
 
-                (void) mask;
-
                 if (!r)
                 {
                     throw std::runtime_error(
@@ -258,9 +521,15 @@ Output::identify(transaction const& tx,
 
                 amount = rct_amount_val;
 
-            } // if (!tx_is_coinbase)
+                if (commitment_verifier)
+                {
+                    commitment_verifier->add(out.key, rtc_outpk,
+                                             amount, mask);
+                }
+
+            } // if (!txo.is_coinbase)
 
-        } // if (mine_output && tx.version == 2)
+        } // if (mine_output && txo.version == 2)
 
         if (mine_output)
         {
@@ -268,7 +537,7 @@ Output::identify(transaction const& tx,
 
             identified_outputs.emplace_back(
                     info{
-                        txout_key.key, amount, i, 
+                        out.key, amount, i, 
                         derivation_to_save,
                         rtc_outpk, rtc_mask, rtc_amount,
                         subaddress_spendkey
@@ -305,13 +574,14 @@ Output::identify(transaction const& tx,
             total_xmr += amount;
         } //  if (mine_output)
 
-    } // for (uint64_t i = 0; i < tx.vout.size(); ++i)
+    } // for (auto const& out: txo.outputs)
 }
 
 
 
+template <typename CryptoPolicy>
 bool
-Output::decode_ringct(rct::rctSig const& rv,
+BasicOutput<CryptoPolicy>::decode_ringct(rct::rctSig const& rv,
               crypto::key_derivation const& derivation,
               unsigned int i,
               rct::key& mask,
@@ -321,30 +591,26 @@ Output::decode_ringct(rct::rctSig const& rv,
     {
         crypto::secret_key scalar1;
 
-        hwdev.derivation_to_scalar(derivation, i, scalar1);
+        CryptoPolicy::derivation_to_scalar(hwdev, derivation, i, scalar1);
 
-        switch (rv.type)
+        // amount is just decoded from ecdhInfo here.
+        // checking its commitment is the costly part, 
+        // so it can be deferred to commitment_verifier
+        if (!decode_rct_amount(rv, rct::sk2rct(scalar1), i,
+                               amount, mask))
         {
-            case rct::RCTTypeSimple:
-            case rct::RCTTypeBulletproof:
-            case rct::RCTTypeBulletproof2:
-            case rct::RCTTypeCLSAG:    
-                amount = rct::decodeRctSimple(rv,
-                                              rct::sk2rct(scalar1),
-                                              i,
-                                              mask,
-                                              hwdev);
-                break;
-            case rct::RCTTypeFull:
-                amount = rct::decodeRct(rv,
-                                        rct::sk2rct(scalar1),
-                                        i,
-                                        mask,
-                                        hwdev);
-                break;
-            default:
-                cerr << "Unsupported rct type: " << rv.type << '\n';
-                return false;
+            cerr << "Failed to decode output " << i << '\n';
+            return false;
+        }
+
+        if (commitment_verifier)
+            return true;
+
+        if (!verify_rct_commitment(rv.outPk[i].mask, amount, mask))
+        {
+            cerr << "Commitment of output " << i 
+                 << " does not match its amount\n";
+            return false;
         }
     }
     catch (...)
@@ -358,43 +624,56 @@ Output::decode_ringct(rct::rctSig const& rv,
 
 
 void Input::identify(transaction const& tx,
-                     public_key const& tx_pub_key,
-                     vector<public_key> const& additional_tx_pub_keys)
+                     ParsedTxExtra const& tx_extra)
 {
+    tx_inputs.set(tx);
+
+    identify(tx_inputs);
+}
+
+void Input::identify(TxInputs const& txi)
+{
+    if (owned_outputs)
+    {
+        identify_owned(txi);
+        return;
+    }
 
     // if known_outputs is null do nothing
     if (!known_outputs)
         return;
 
-     //auto search_misses {0};
+     // all ring members are read in
+     // one read transaction
+     ReadSnapshot snapshot {mcore};
 
-     auto input_no = tx.vin.size();
+     // copied, as inputs with non-existing offsets
+     // are removed from them below
+     in_keys = txi.in_keys;
+     rings = txi.rings;
 
-     for (auto i = 0u; i < input_no; ++i)
-     {
-         if(tx.vin[i].type() != typeid(txin_to_key))
-             continue;
+     // before we procced to fetch the outputs from lmdb
+     // check if we are not trying to get the outputs
+     // with non-existing offsets. Number of outputs
+     // is checked only once for each amount.
 
-         // get tx input key
-         txin_to_key const& in_key
-                 = boost::get<txin_to_key>(tx.vin[i]);
+     std::map<uint64_t, uint64_t> num_outputs;
 
-         // get absolute offsets of mixins
-         vector<uint64_t> absolute_offsets
-                 = relative_output_offsets_to_absolute(
-                         in_key.key_offsets);
+     auto no_of_rings = 0u;
 
-         // get public keys of outputs used in the mixins that
-         // match to the offests
-         vector<output_data_t> mixin_outputs;
+     for (auto i = 0u; i < rings.size(); ++i)
+     {
+         auto const& amount = rings[i].first;
 
-         // before we procced to fetch the outputs from lmdb
-         // check if we are not trying to get the outputs
-         // with non-existing offsets
+         auto it = num_outputs.find(amount);
 
-         auto num_outputs = mcore->get_num_outputs(in_key.amount);
+         if (it == num_outputs.end())
+         {
+             it = num_outputs.emplace(
+                     amount, mcore->get_num_outputs(amount)).first;
+         }
 
-         if (absolute_offsets.back() >= num_outputs)
+         if (rings[i].second.back() >= it->second)
          {
              //cerr << "skipping offset" << endl;
              // we try to get output with offset 
@@ -402,17 +681,28 @@ void Input::identify(transaction const& tx,
              continue;
          }
 
-         // this can THROW if no outputs are found
-         // but previous check should prevent this
-         mcore->get_output_key(in_key.amount,
-                               absolute_offsets,
-                               mixin_outputs);
+         in_keys[no_of_rings] = in_keys[i];
+         std::swap(rings[no_of_rings], rings[i]);
+         ++no_of_rings;
+     }
+
+     in_keys.resize(no_of_rings);
+     rings.resize(no_of_rings);
 
-         // indicates whether we found any matching mixin in the current input
-         auto found_a_match {false};
+     // get public keys of outputs used in the mixins that
+     // match to the offests for all the inputs at once.
+     // this can THROW if no outputs are found
+     // but previous check should prevent this
+     mcore->get_output_keys(rings, rings_outputs);
+
+     for (auto i = 0u; i < in_keys.size(); ++i)
+     {
+         txin_to_key const& in_key = *in_keys[i];
+
+         vector<output_data_t> const& mixin_outputs = rings_outputs[i];
 
          // for each found output public key check if its ours or not
-         for (auto count = 0u; count < absolute_offsets.size(); ++count)
+         for (auto count = 0u; count < mixin_outputs.size(); ++count)
          {
              // get basic information about mixn's output
              output_data_t const& output_data
@@ -435,32 +725,155 @@ void Input::identify(transaction const& tx,
                          output_data.pubkey});
 
                  total_xmr += it->second;
-
-                 found_a_match = true;
              }  
 
          } // for (const cryptonote::output_data_t& output_data: outputs)
 
-//         if (found_a_match == false)
-//         {
-//             // if we didnt find any match, break of the look.
-//             // there is no reason to check remaining key images
-//             // as when we spent something, our outputs should be
-//             // in all inputs in a given txs. Thus, if a single input
-//             // is without our output, we can assume this tx does
-//             // not contain any of our spendings.
+     } //  for (auto i = 0u; i < in_keys.size(); ++i)
+}
+
+void
+Input::identify_owned(TxInputs const& txi)
+{
+    // ring members are referred by amounts and global
+    // indices, same as outputs in the index. so no
+    // lmdb reads are needed, only a lookup 
+    // for each ring member
+    for (auto i = 0u; i < txi.in_keys.size(); ++i)
+    {
+        txin_to_key const& in_key = *txi.in_keys[i];
+
+        auto const& ring = txi.rings[i];
+
+        for (auto const& global_idx: ring.second)
+        {
+            auto const* out = owned_outputs->find(ring.first, global_idx);
+
+            if (!out)
+                continue;
+
+            identified_inputs.push_back(info {
+                    in_key.k_image,
+                    out->amount,
+                    out->pub_key});
+
+            total_xmr += out->amount;
+        }
+    }
+}
+
+void
+TxInputs::set(transaction const& tx)
+{
+    in_keys.clear();
+
+    for (auto const& in: tx.vin)
+    {
+        if(in.type() != typeid(txin_to_key))
+            continue;
+
+        // get tx input key
+        txin_to_key const& in_key = boost::get<txin_to_key>(in);
+
+        if (in_key.key_offsets.empty())
+            continue;
 
-//             // just to be sure before we break out of this loop,
-//             // do it only after two misses
+        in_keys.push_back(&in_key);
+    }
+
+    // rings are resized rather than cleared, so that 
+    // vectors of offsets from previous tx are reused
+    rings.resize(in_keys.size());
+
+    for (auto i = 0u; i < in_keys.size(); ++i)
+    {
+        auto& ring = rings[i];
+
+        ring.first = in_keys[i]->amount;
 
-//            // if (++search_misses > 2)
-//               //  break;
-//         }
+        // get absolute offsets of mixins, same as
+        // relative_output_offsets_to_absolute does
+        ring.second.assign(in_keys[i]->key_offsets.begin(),
+                           in_keys[i]->key_offsets.end());
 
-     } //  for (auto i = 0u; i < input_no; ++i)
+        for (auto j = 1u; j < ring.second.size(); ++j)
+            ring.second[j] += ring.second[j - 1];
+    }
 }
 
 
+vector<Output::info>
+Input::get_mixin_outputs(crypto::hash const& mixin_tx_hash)
+{
+    // outputs found for PrimaryAccount can include its 
+    // subaddresses, so we need to distinguish them in
+    // the cache from outputs found only for an address
+    MixinTxCache::account_key_t acc_key {
+        get_address()->address.m_spend_public_key,
+        get_address()->address.m_view_public_key,
+        acc && !acc->is_subaddress()};
+
+    vector<Output::info> found_outputs;
+
+    if (tx_cache && tx_cache->get_outputs(mixin_tx_hash, 
+                                          acc_key, found_outputs))
+    {
+        return found_outputs;
+    }
+
+    shared_ptr<transaction const> mixin_tx;
+
+    if (tx_cache)
+    {
+        mixin_tx = tx_cache->get_tx(mixin_tx_hash, mcore);
+    }
+    else
+    {
+        auto tx = make_shared<transaction>();
+
+        if (mcore->get_pruned_tx(mixin_tx_hash, *tx))
+            mixin_tx = std::move(tx);
+    }
+
+    if (!mixin_tx)
+    {
+        throw std::runtime_error("Cant get tx: "
+                                 + pod_to_hex(mixin_tx_hash));
+    }
+
+    // use Output universal identifier to identify our outputs
+    // in a mixin tx
+
+    std::unique_ptr<Output> output_identifier;
+
+    if (acc)
+    {
+        output_identifier = make_unique<Output>(acc);
+    }
+    else
+    {
+        output_identifier = make_unique<Output>(
+                get_address(), get_viewkey());
+    }
+
+    // same mixin txs are used in many rings, so their
+    // derivations are likely to be known already
+    output_identifier->set_derivation_cache(derivation_cache);
+
+    ParsedTxExtra mixin_tx_extra;
+
+    mixin_tx_extra.set(*mixin_tx);
+
+    output_identifier->identify(*mixin_tx, mixin_tx_extra);
+
+    found_outputs = output_identifier->get();
+
+    if (tx_cache)
+        tx_cache->set_outputs(mixin_tx_hash, acc_key, found_outputs);
+
+    return found_outputs;
+}
+
 /*
  * Generate key_image of foran ith output
  */
@@ -511,48 +924,37 @@ Input::generate_key_image(const crypto::key_derivation& derivation,
 }
 
 void
-GuessInput::identify(transaction const& tx,
-                     public_key const& tx_pub_key,
-                     vector<public_key> const& additional_tx_pub_keys)
+GuessInput::identify(TxInputs const& txi)
 {
+    // if our outputs are already known, just
+    // check ring members against them
+    if (use_known_outputs)
+    {
+        Input::identify(txi);
+        return;
+    }
+
     // to implement this method, we are just going
     // to generate known_outputs_t = unordered_map<public_key, uint64_t>;
     // based on ring members in each key image, and then
     // we will call identify method of the Input base class.
 
-    // this will store guessed inputs
-    vector<info> local_identified_inputs;
-        
     // will keep output public key and amount
     // of mixins in the given key image which
     // are ours.
-    known_outputs_t known_outputs_map;
+    known_outputs_map.clear();
 
-    auto input_no = tx.vin.size();
-           
-    for (auto i = 0u; i < input_no; ++i)
-    {
-        if(tx.vin[i].type() != typeid(txin_to_key))
-            continue;
-
-        // get tx input key
-        txin_to_key const& in_key
-                = boost::get<cryptonote::txin_to_key>(tx.vin[i]);
+    // ring members and mixin txs are read
+    // in one read transaction
+    ReadSnapshot snapshot {mcore};
 
-        // get absolute offsets of mixins
-        auto absolute_offsets
-                = relative_output_offsets_to_absolute(
-                        in_key.key_offsets);
-
-        //tx_out_index is pair::<transaction hash, output index>
-        vector<tx_out_index> indices;
-
-        // get tx hashes and indices in the txs for the
-        // given outputs of mixins
-        //  this cant THROW DB_EXCEPTION
-        mcore->get_output_tx_and_index(
-                    in_key.amount, absolute_offsets, indices);
+    // get tx hashes and indices in the txs for the
+    // given outputs of mixins of all the inputs at once
+    //  this cant THROW DB_EXCEPTION
+    mcore->get_output_tx_and_indices(txi.rings, rings_indices);
 
+    for (auto const& indices: rings_indices)
+    {
         // for each found mixin tx, check if any key image
         // generated using our outputs in the mixin tx
         // matches the given key image in the current tx
@@ -560,35 +962,7 @@ GuessInput::identify(transaction const& tx,
         {
            auto const& mixin_tx_hash = txi.first;          
 
-           transaction mixin_tx;
-
-           if (!mcore->get_tx(mixin_tx_hash, mixin_tx))
-           {
-               throw std::runtime_error("Cant get tx: "
-                                        + pod_to_hex(mixin_tx_hash));
-           }
-
-           // use Output universal identifier to identify our outputs
-           // in a mixin tx
-
-           std::unique_ptr<Output> output_identifier;
-
-           if (acc)
-           {
-               output_identifier = make_unique<Output>(acc);
-           }
-           else
-           {
-               output_identifier = make_unique<Output>(
-                       get_address(), get_viewkey());
-           }
-
-           auto identifier = make_identifier(
-                       mixin_tx, std::move(output_identifier));
-
-           identifier.identify();
-
-           for (auto const& found_output: identifier.get<Output>()->get())
+           for (auto const& found_output: get_mixin_outputs(mixin_tx_hash))
            {
                // add found output into the map of known ouputs
                known_outputs_map.insert(
@@ -602,7 +976,7 @@ GuessInput::identify(transaction const& tx,
         // guess which of them was used in the current
         // key image.
 
-    } // for (auto i = 0u; i < input_no; ++i)
+    } // for (auto const& indices: rings_indices)
         
     // to do this, set known_outputs to the known_outputs_map
     known_outputs = &known_outputs_map;
@@ -610,51 +984,27 @@ GuessInput::identify(transaction const& tx,
     // and now execute baseclasses (i.e. Input) identify
     // method. The method will use known_outputs as
     // its list of outputs
-    Input::identify(tx, tx_pub_key, additional_tx_pub_keys);
-    
-    // copy what was identified using Input::identify
-    // into local_identified_inputs
-    local_identified_inputs.insert(local_identified_inputs.end(),
-                                   identified_inputs.begin(),
-                                   identified_inputs.end());
-
-
-    // once all key images have been scanned,
-    // copy local_identified_inputs into identified_inputs
-    // so that we can return them to the end user
-    identified_inputs = std::move(local_identified_inputs);
+    Input::identify(txi);
 }
 
 
-void RealInput::identify(transaction const& tx,
-                         public_key const& tx_pub_key,
-                         vector<public_key> const& additional_tx_pub_keys)
+template <typename CryptoPolicy>
+void BasicRealInput<CryptoPolicy>::identify(TxInputs const& txi)
 {
-     auto input_no = tx.vin.size();
-
-     for (auto i = 0u; i < input_no; ++i)
-     {
-         if(tx.vin[i].type() != typeid(txin_to_key))
-             continue;
-
-         // get tx input key
-         txin_to_key const& in_key
-                 = boost::get<cryptonote::txin_to_key>(tx.vin[i]);
+     // ring members and mixin txs are read
+     // in one read transaction
+     ReadSnapshot snapshot {mcore};
 
-         // get absolute offsets of mixins
-         auto absolute_offsets
-                 = relative_output_offsets_to_absolute(
-                         in_key.key_offsets);
+     // get tx hashes and indices in the txs for the
+     // given outputs of mixins of all the inputs at once
+     //  this cant THROW DB_EXCEPTION
+     mcore->get_output_tx_and_indices(txi.rings, rings_indices);
 
+     for (auto i = 0u; i < txi.in_keys.size(); ++i)
+     {
+         txin_to_key const& in_key = *txi.in_keys[i];
 
-         //tx_out_index is pair::<transaction hash, output index>
-         vector<tx_out_index> indices;
-
-         // get tx hashes and indices in the txs for the
-         // given outputs of mixins
-         //  this cant THROW DB_EXCEPTION
-         mcore->get_output_tx_and_index(
-                     in_key.amount, absolute_offsets, indices);
+         vector<tx_out_index> const& indices = rings_indices[i];
 
          // placeholder for information about key image that
          // we will find as ours
@@ -667,37 +1017,7 @@ void RealInput::identify(transaction const& tx,
          {
             auto const& mixin_tx_hash = txi.first;         
 
-            transaction mixin_tx;
-
-            if (!mcore->get_tx(mixin_tx_hash, mixin_tx))
-            {
-                throw std::runtime_error("Cant get tx: "
-                                         + pod_to_hex(mixin_tx_hash));
-            }
-
-            // use Output universal identifier to identify our outputs
-            // in a mixin tx
-           
-            std::unique_ptr<Output> output_identifier;
-
-            if (acc)
-            {
-                output_identifier = make_unique<Output>(acc);
-            }
-            else
-            {
-                output_identifier = make_unique<Output>(
-                       get_address(), get_viewkey());
-            }
-
-            auto identifier = make_identifier(
-                       mixin_tx, std::move(output_identifier));
-
-            identifier.identify();
-
-            //cout << "mixin tx hash: " << get_transaction_hash(mixin_tx) << '\n';
-
-            for (auto const& found_output: identifier.get<Output>()->get())
+            for (auto const& found_output: get_mixin_outputs(mixin_tx_hash))
             {
                 //cout << "found_output: " << found_output << endl;
 
@@ -713,21 +1033,16 @@ void RealInput::identify(transaction const& tx,
                     // for spendings from subaddresses, use the below procedure
                     // to calcualted key_img_generated
                     
-                    cryptonote::keypair in_ephemeral;
-                    
-                    if (!generate_key_image_helper_precomp(*acc->keys(), 
-                                                      found_output.pub_key,
-                                                      found_output.derivation,
-                                                      found_output.idx_in_tx,
-                                                      found_output.subaddr_idx,
-                                                      in_ephemeral,
-                                                      key_img_generated,
-                                                      hwdev))
+                    if (!CryptoPolicy::generate_key_image(
+                                hwdev, *acc->keys(), 
+                                found_output.pub_key,
+                                found_output.derivation,
+                                found_output.idx_in_tx,
+                                found_output.subaddr_idx,
+                                key_img_generated))
                     {
                         throw std::runtime_error("Cant get key_img_generated");
                     }
-
-                    (void) in_ephemeral;
                 }
                 else
                 {
@@ -777,9 +1092,15 @@ void RealInput::identify(transaction const& tx,
 
          } // for (auto const& txi : indices)
 
-     } //  for (auto i = 0u; i < input_no; ++i)
+     } //  for (auto i = 0u; i < txi.in_keys.size(); ++i)
 }
 
+template class BasicOutput<DeviceCrypto>;
+template class BasicOutput<SoftwareCrypto>;
+
+template class BasicRealInput<DeviceCrypto>;
+template class BasicRealInput<SoftwareCrypto>;
+
 
 
 // just a copy from bool
@@ -799,7 +1120,11 @@ PaymentID<HashT>::encrypt_payment_id(
     crypto::hash hash;
     char data[33]; /* A hash, and an extra byte */
 
-    if (!generate_key_derivation(public_key, secret_key, derivation))
+    bool derivation_generated = derivation_cache
+            ? derivation_cache->get(public_key, secret_key, derivation)
+            : generate_key_derivation(public_key, secret_key, derivation);
+
+    if (!derivation_generated)
         return false;
 
     memcpy(data, &derivation, 32);
@@ -829,34 +1154,11 @@ typename PaymentID<HashT>::payments_t
 PaymentID<HashT>::get_payment_id(
         transaction const& tx) const
 {
-    crypto::hash payment_id {0};
-    crypto::hash8 payment_id8 {0};
-
-    std::vector<tx_extra_field> tx_extra_fields;
+    ParsedTxExtra tx_extra;
 
-    if(!parse_tx_extra(tx.extra, tx_extra_fields))
-    {
-        return make_tuple(payment_id, payment_id8);
-    }
-
-    tx_extra_nonce extra_nonce;
-
-    if (find_tx_extra_field_by_type(tx_extra_fields, extra_nonce))
-    {
-        // first check for encrypted id and then for normal one
-        if(get_encrypted_payment_id_from_tx_extra_nonce(extra_nonce.nonce, 
-                    payment_id8))
-        {
-            return make_tuple(payment_id, payment_id8);
-        }
-        else if (get_payment_id_from_tx_extra_nonce(extra_nonce.nonce, 
-                    payment_id))
-        {
-            return make_tuple(payment_id, payment_id8);
-        }
-    }
+    tx_extra.set(tx);
 
-    return make_tuple(payment_id, payment_id8);
+    return make_tuple(tx_extra.payment_id, tx_extra.payment_id8);
 }
 
 template tuple<crypto::hash, crypto::hash8> 
@@ -2,8 +2,13 @@
 
 #include "MicroCore.h"
 #include "Account.h"
+#include "DerivationCache.h"
+#include "ScanTx.h"
+#include "RctAmountDecoder.h"
 
+#include <algorithm>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 namespace xmreg
@@ -18,14 +23,54 @@ using namespace std;
 public_key
 get_tx_pub_key_from_received_outs(transaction const& tx);
 
+class MixinTxCache;
+
+/**
+ * Fields of tx extra used by identifiers.
+ *
+ * tx extra is parsed only once per tx, 
+ * e.g., in ModularIdentifier, and then passed to 
+ * all its identifiers, rather than parsed by
+ * each identifier again.
+ */
+struct ParsedTxExtra
+{
+    public_key tx_pub_key {null_pkey};
+
+    // multi-output txs to subaddresses have
+    // additional public keys
+    vector<public_key> additional_tx_pub_keys;
+
+    // empty if tx has no nonce
+    blobdata nonce;
+
+    // payment ids from the nonce. null hashes
+    // if there are none. integrated payment id
+    // is still encrypted here.
+    crypto::hash payment_id {};
+    crypto::hash8 payment_id8 {};
+
+    void
+    set(transaction const& tx);
+
+private:
+    // kept between txs to reuse its memory
+    vector<tx_extra_field> tx_extra_fields;
+
+    // fields are copied into these by 
+    // find_tx_extra_field_by_type and then swapped with 
+    // the members above. so buffers of both are kept 
+    // between txs, and are not allocated for each tx again
+    tx_extra_additional_pub_keys additional_pub_keys;
+    tx_extra_nonce extra_nonce;
+};
+
 
 class AbstractIdentifier
 {
 public:
     virtual void identify(transaction const& tx,
-                          public_key const& tx_pub_key,
-                          vector<public_key> const& additional_tx_pub_keys
-                                = vector<public_key>{}) = 0;
+                          ParsedTxExtra const& tx_extra) = 0;
 };
 
 
@@ -46,9 +91,22 @@ public:
    }
 
     virtual void identify(transaction const& tx,
-                          public_key const& tx_pub_key,
-                          vector<public_key> const& additional_tx_pub_keys
-                                = vector<public_key>{}) = 0;
+                          ParsedTxExtra const& tx_extra) = 0;
+
+    /**
+     * Clears results of the previous identify call,
+     * so that the identifier can be used for another tx.
+     * Allocated memory is kept for the next tx.
+     */
+    virtual void reset() {total_xmr = 0;}
+
+    /**
+     * Key derivations are going to be taken from 
+     * the cache, if they are there. ModularIdentifier
+     * sets same cache for all its identifiers.
+     */
+    inline void set_derivation_cache(DerivationCache* _derivation_cache)
+    {derivation_cache = _derivation_cache;}
 
     inline auto get_address() const {return address_info;}
     inline auto get_viewkey() const {return viewkey;}
@@ -57,33 +115,227 @@ public:
     virtual ~BaseIdentifier() = default;
 
 protected:
+
+    /**
+     * Derivation of the given public key and our viewkey,
+     * using derivation_cache if its set
+     */
+    bool
+    get_derivation(public_key const& pub_key,
+                   key_derivation& derivation) const;
+
     address_parse_info const* address_info {nullptr};
     secret_key const* viewkey {nullptr};
     uint64_t total_xmr {0};
     Account* acc {nullptr};
     hw::device& hwdev;
+    DerivationCache* derivation_cache {nullptr};
+};
+
+/**
+ * Account independent information about outputs
+ * of a given tx. Getting it does not require viewkey,
+ * thus it can be done only once per tx and then
+ * shared by Output identifiers of many accounts.
+ *
+ * It points to data in the tx, so it can't outlive it.
+ */
+struct TxOutputs
+{
+    struct output
+    {
+        public_key key;
+        uint64_t   amount;
+        uint64_t   idx_in_tx;
+
+        // output's public key decompressed into
+        // a curve point. every account checking
+        // the output would need to do it anyway.
+        ge_p3      key_point;
+
+        // only txout_to_tagged_key outputs have it
+        bool       has_view_tag {false};
+        crypto::view_tag view_tag;
+    };
+
+    bool is_coinbase {false};
+    size_t version {0};
+    rct::rctSig const* rct_signatures {nullptr};
+
+    public_key tx_pub_key;
+    vector<public_key> const* additional_tx_pub_keys {nullptr};
+
+    vector<output> outputs;
+
+    void
+    set(transaction const& tx, ParsedTxExtra const& tx_extra);
+};
+
+/**
+ * Account independent information about inputs
+ * of a given tx, i.e., txin_to_key inputs and their 
+ * rings: amounts and absolute offsets of ring members, 
+ * so that ring members of all inputs can be fetched 
+ * from lmdb at once. Like TxOutputs, it can be 
+ * obtained once per tx and shared by Input identifiers.
+ *
+ * It points to data in the tx, so it can't outlive it.
+ */
+struct TxInputs
+{
+    vector<txin_to_key const*> in_keys;
+    vector<AbstractCore::ring_t> rings;
+
+    void
+    set(transaction const& tx);
+};
+
+/**
+ * Crypto operations with our secret keys, which the
+ * identifiers need to do for outputs that are ours.
+ *
+ * DeviceCrypto does them through hw::device, as 
+ * monero's wallet does. SoftwareCrypto calls crypto 
+ * functions directly, without virtual calls and copies 
+ * into rct::key, but it works only for keys which are in 
+ * memory. As identifiers always use the "default" device,
+ * both give same results.
+ */
+struct DeviceCrypto
+{
+    static void
+    derivation_to_scalar(hw::device& hwdev,
+                         key_derivation const& derivation,
+                         size_t output_index,
+                         secret_key& scalar)
+    {
+        hwdev.derivation_to_scalar(derivation, output_index, scalar);
+    }
+
+    static bool
+    generate_key_image(hw::device& hwdev,
+                       account_keys const& keys,
+                       public_key const& out_key,
+                       key_derivation const& derivation,
+                       size_t output_index,
+                       subaddress_index const& subaddr_idx,
+                       key_image& key_img)
+    {
+        keypair in_ephemeral;
+
+        return generate_key_image_helper_precomp(
+                    keys, out_key, derivation, output_index,
+                    subaddr_idx, in_ephemeral, key_img, hwdev);
+    }
+};
+
+struct SoftwareCrypto
+{
+    static void
+    derivation_to_scalar(hw::device& hwdev,
+                         key_derivation const& derivation,
+                         size_t output_index,
+                         secret_key& scalar)
+    {
+        crypto::derivation_to_scalar(derivation, output_index, scalar);
+    }
+
+    static bool
+    generate_key_image(hw::device& hwdev,
+                       account_keys const& keys,
+                       public_key const& out_key,
+                       key_derivation const& derivation,
+                       size_t output_index,
+                       subaddress_index const& subaddr_idx,
+                       key_image& key_img);
+};
+
+struct OutputInfo
+{
+    public_key pub_key;
+    uint64_t   amount;
+    uint64_t   idx_in_tx;
+    key_derivation derivation;
+    rct::key   rtc_outpk;
+    rct::key   rtc_mask;
+    rct::key   rtc_amount;
+
+    public_key subaddress_spendkey;
+    subaddress_index subaddr_idx {
+        UINT32_MAX, UINT32_MAX};
+        // the max value means not given
+    
+    bool has_subaddress_index() const
+    {
+        return subaddr_idx.major != UINT32_MAX
+            && subaddr_idx.minor != UINT32_MAX;
+    }
+        
+    friend std::ostream& operator<<(std::ostream& os,
+                                    OutputInfo const& _info);
 };
 
 /**
  * @brief The Output class identifies our
  * outputs in a given tx
+ *
+ * CryptoPolicy is DeviceCrypto or SoftwareCrypto.
+ * Results of both are of the same type, OutputInfo.
  */
-class Output : public BaseIdentifier
+template <typename CryptoPolicy>
+class BasicOutput : public BaseIdentifier
 {
 public:
 
     using BaseIdentifier::BaseIdentifier;
 
     void identify(transaction const& tx,
-                  public_key const& tx_pub_key,
-                  vector<public_key> const& additional_tx_pub_keys
-                        = vector<public_key>{}) override;
+                  ParsedTxExtra const& tx_extra) override;
+
+    /**
+     * Identify outputs using already extracted 
+     * outputs' information. Useful when we 
+     * check same tx for many accounts.
+     */
+    void identify(TxOutputs const& txo);
+
+    void reset() override
+    {
+        BaseIdentifier::reset();
+        identified_outputs.clear();
+        total_received = 0;
+        view_tag_rejected = 0;
+    }
 
-    inline auto get() const
+    // results of the last identified tx. they
+    // are not copied, so they are valid only
+    // until next identify or reset
+    inline auto const& get() const
     {
         return identified_outputs;
     }
 
+    // number of outputs skipped only based on
+    // their view tags, i.e., without deriving 
+    // their subaddress spendkeys
+    inline auto get_view_tag_rejected() const
+    {
+        return view_tag_rejected;
+    }
+
+
+    /**
+     * Commitments of our outputs are not checked 
+     * when their amounts are decoded, but added to the
+     * verifier, to be verified later on all at once,
+     * e.g., for a whole block. nullptr, the default, 
+     * checks them right away.
+     */
+    inline void 
+    set_commitment_verifier(CommitmentVerifier* verifier)
+    {
+        commitment_verifier = verifier;
+    }
 
     bool
     decode_ringct(rct::rctSig const& rv,
@@ -92,37 +344,28 @@ public:
                   rct::key& mask,
                   uint64_t& amount) const;
 
-    struct info
-    {
-        public_key pub_key;
-        uint64_t   amount;
-        uint64_t   idx_in_tx;
-        key_derivation derivation;
-        rct::key   rtc_outpk;
-        rct::key   rtc_mask;
-        rct::key   rtc_amount;
-
-        public_key subaddress_spendkey;
-        subaddress_index subaddr_idx {
-            UINT32_MAX, UINT32_MAX};
-            // the max value means not given
-        
-        bool has_subaddress_index() const
-        {
-            return subaddr_idx.major != UINT32_MAX
-                && subaddr_idx.minor != UINT32_MAX;
-        }
-            
-        friend std::ostream& operator<<(std::ostream& os,
-                                        info const& _info);
-    };
+    using info = OutputInfo;
 
 protected:
 
     uint64_t total_received {0};
+    uint64_t view_tag_rejected {0};
     vector<info> identified_outputs;
+
+    // used when we identify outputs using
+    // identify(tx, tx_extra)
+    TxOutputs tx_outputs;
+
+    vector<key_derivation> additional_derivations;
+
+    CommitmentVerifier* commitment_verifier {nullptr};
 };
 
+using Output = BasicOutput<DeviceCrypto>;
+using SoftwareOutput = BasicOutput<SoftwareCrypto>;
+
+class OwnedOutputIndex;
+
 /**
  * @brief The Input class identifies our possible
  * inputs (key images) in a given tx
@@ -151,11 +394,25 @@ public:
     {}
 
     void identify(transaction const& tx,
-                  public_key const& tx_pub_key,
-                  vector<public_key> const& additional_tx_pub_keys
-                        = vector<public_key>{}) override;
+                  ParsedTxExtra const& tx_extra) override;
 
-    inline auto get() const
+    /**
+     * Identify inputs using already extracted 
+     * inputs' rings. Useful when we check same 
+     * tx for many accounts, or with other identifiers.
+     */
+    virtual void identify(TxInputs const& txi);
+
+    void reset() override
+    {
+        BaseIdentifier::reset();
+        identified_inputs.clear();
+    }
+
+    // results of the last identified tx. they
+    // are not copied, so they are valid only
+    // until next identify or reset
+    inline auto const& get() const
     {
         return identified_inputs;
     }
@@ -167,6 +424,14 @@ public:
                       const crypto::public_key& pub_key,
                       crypto::key_image& key_img) const;
 
+    /**
+     * Mixin txs and our outputs in them are going 
+     * to be taken from the cache, if they are there.
+     * The cache can be shared by many identifiers.
+     */
+    inline void set_tx_cache(MixinTxCache* _tx_cache)
+    {tx_cache = _tx_cache;}
+
     struct info
     {
         key_image key_img;
@@ -180,10 +445,35 @@ public:
 
 protected:
 
+    /**
+     * Identifies our outputs in a mixin tx
+     * of the given hash
+     */
+    vector<Output::info>
+    get_mixin_outputs(crypto::hash const& mixin_tx_hash);
+
+    /**
+     * Identifies inputs using rings' absolute offsets
+     * and global indices of outputs in owned_outputs
+     */
+    void
+    identify_owned(TxInputs const& txi);
+
     secret_key const* viewkey {nullptr};   
     known_outputs_t const* known_outputs {nullptr};
+    OwnedOutputIndex const* owned_outputs {nullptr};
     AbstractCore const* mcore {nullptr};
+    MixinTxCache* tx_cache {nullptr};
     vector<info> identified_inputs;
+
+    // kept between txs, so that their memory
+    // can be reused
+    TxInputs tx_inputs;
+    vector<txin_to_key const*> in_keys;
+    vector<AbstractCore::ring_t> rings;
+    vector<vector<output_data_t>> rings_outputs;
+    //tx_out_index is pair::<transaction hash, output index>
+    vector<vector<tx_out_index>> rings_indices;
 };
 
 /**
@@ -206,11 +496,72 @@ public:
         : Input(_acc, nullptr, _mcore)
     {}
 
-    void identify(transaction const& tx,
-                  public_key const& tx_pub_key,
-                  vector<public_key> const& additional_tx_pub_keys
-                        = vector<public_key>{}) override;
+    /**
+     * If we already know our outputs, e.g., from
+     * OwnedOutputIndex populated while scanning blockchain,
+     * there is no need to look for them in ring members' txs.
+     * The known outputs are used directly instead.
+     */
+    GuessInput(Account* _acc, MicroCore* _mcore,
+               known_outputs_t const* _known_outputs)
+        : Input(_acc, _known_outputs, _mcore),
+          use_known_outputs {_known_outputs != nullptr}
+    {}
+
+    GuessInput(address_parse_info const* _a,
+               secret_key const* _viewkey,
+               MicroCore* _mcore,
+               known_outputs_t const* _known_outputs)
+        : Input(_a, _viewkey, _known_outputs, _mcore),
+          use_known_outputs {_known_outputs != nullptr}
+    {}
+
+    /**
+     * With OwnedOutputIndex, absolute offsets of rings 
+     * are checked against global indices of our outputs 
+     * directly, so ring members are not read from 
+     * lmdb at all.
+     */
+    GuessInput(Account* _acc, MicroCore* _mcore,
+               OwnedOutputIndex const* _owned_outputs)
+        : Input(_acc, nullptr, _mcore),
+          use_known_outputs {_owned_outputs != nullptr}
+    {
+        owned_outputs = _owned_outputs;
+    }
+
+    GuessInput(address_parse_info const* _a,
+               secret_key const* _viewkey,
+               MicroCore* _mcore,
+               OwnedOutputIndex const* _owned_outputs)
+        : Input(_a, _viewkey, nullptr, _mcore),
+          use_known_outputs {_owned_outputs != nullptr}
+    {
+        owned_outputs = _owned_outputs;
+    }
+
+    // without known outputs or OwnedOutputIndex, so that
+    // calls with nullptr are not ambiguous
+    GuessInput(Account* _acc, MicroCore* _mcore, std::nullptr_t)
+        : GuessInput(_acc, _mcore)
+    {}
 
+    GuessInput(address_parse_info const* _a,
+               secret_key const* _viewkey,
+               MicroCore* _mcore,
+               std::nullptr_t)
+        : GuessInput(_a, _viewkey, _mcore)
+    {}
+
+    using Input::identify;
+
+    void identify(TxInputs const& txi) override;
+
+protected:
+    bool use_known_outputs {false};
+
+    // our outputs found in ring members' txs
+    known_outputs_t known_outputs_map;
 };
 
 /**
@@ -220,36 +571,39 @@ public:
  * in unit testing, since we can compare wether
  * guessed key images do contain all our key images
  */
-class RealInput : public Input
+template <typename CryptoPolicy>
+class BasicRealInput : public Input
 {
 
 public:
 
-    RealInput(address_parse_info const* _a,
-              secret_key const* _viewkey,
-              secret_key const* _spendkey,
-              MicroCore* _mcore)
+    BasicRealInput(address_parse_info const* _a,
+                   secret_key const* _viewkey,
+                   secret_key const* _spendkey,
+                   MicroCore* _mcore)
         : Input(_a, _viewkey, nullptr, _mcore),
           spendkey {_spendkey}
     {}
     
-    RealInput(Account* _acc, MicroCore* _mcore)
+    BasicRealInput(Account* _acc, MicroCore* _mcore)
         : Input(_acc, nullptr, _mcore)
     {
         assert(_acc->sk());
         spendkey = &(*_acc->sk());
     }
 
-    void identify(transaction const& tx,
-                  public_key const& tx_pub_key,
-                  vector<public_key> const& additional_tx_pub_keys
-                        = vector<public_key>{}) override;
+    using Input::identify;
+
+    void identify(TxInputs const& txi) override;
 
 
 protected:
     secret_key const* spendkey {nullptr};
 };
 
+using RealInput = BasicRealInput<DeviceCrypto>;
+using SoftwareRealInput = BasicRealInput<SoftwareCrypto>;
+
 
 template <typename HashT>
 class PaymentID : public BaseIdentifier
@@ -273,13 +627,12 @@ public:
     {}
 
     void identify(transaction const& tx,
-                  public_key const& tx_pub_key,
-                  vector<public_key> const& additional_tx_pub_keys
-                        = vector<public_key>{}) override
+                  ParsedTxExtra const& tx_extra) override
     {   
         // get payment id. by default we are intrested
         // in short ids from integrated addresses
-        payment_id_tuple = get_payment_id(tx);
+        payment_id_tuple = make_tuple(tx_extra.payment_id,
+                                      tx_extra.payment_id8);
 
         payment_id = std::get<HashT>(payment_id_tuple);
         
@@ -303,7 +656,7 @@ public:
 
         // decrypt integrated payment id. if its legacy payment id
         // nothing will happen.
-        if (!decrypt(*payment_id, tx_pub_key))
+        if (!decrypt(*payment_id, tx_extra.tx_pub_key))
         {
             throw std::runtime_error("Cant decrypt pay_id: "
                                      + pod_to_hex(payment_id));
@@ -312,6 +665,13 @@ public:
 
     }
 
+    void reset() override
+    {
+        BaseIdentifier::reset();
+        payment_id = boost::none;
+        payment_id_tuple = payments_t {};
+    }
+
     payments_t
     get_payment_id(transaction const& tx) const;
 
@@ -364,28 +724,73 @@ public:
 
     ModularIdentifier(transaction const& _tx,
                       unique_ptr<T>... args)
-        : identifiers {move(args)...},
-          tx {_tx}
+        : ModularIdentifier(move(args)...)
     {
-        // having tx public key is very common for all identifiers
-        // so we can get it here, instead of just obtaining it
-        // for each identifier seprately
-        tx_pub_key = get_tx_pub_key_from_received_outs(tx);
+        set_tx(_tx);
+    }
 
-        // multi-output txs can have some additional public keys
-        // in the extra field. So we also get them, just in case
-        additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(tx);
+    /**
+     * Identifier without a tx. Txs are given
+     * to identify(tx) later on, so that same identifiers
+     * can be reused for all txs in, e.g., a block range,
+     * without allocating them for each tx again.
+     */
+    ModularIdentifier(unique_ptr<T>... args)
+        : identifiers {move(args)...},
+          derivation_cache {make_unique<DerivationCache>()}
+    {
+        // all identifiers share same key derivations, e.g.,
+        // Output and IntegratedPaymentID need the same one
+        auto b = {(std::get<unique_ptr<T>>(
+                        identifiers)->set_derivation_cache(
+                            derivation_cache.get()), true)...};
+        (void) b;
     }
 
     void identify()
     {
+         if (!tx)
+             throw std::runtime_error("No tx to identify");
+
          auto b = {(std::get<unique_ptr<T>>(
-                        identifiers)->identify(
-                            tx, tx_pub_key, additional_tx_pub_keys),
+                        identifiers)->identify(*tx, tx_extra),
                    true)...};
          (void) b;
     }
 
+    /**
+     * Identifies a new tx. Results of the previous tx
+     * are removed from the identifiers first.
+     */
+    void identify(transaction const& _tx)
+    {
+        reset();
+        set_tx(_tx);
+        identify();
+    }
+
+    /**
+     * Same as above, but for tx parsed only up to its
+     * ringct base. All identifiers work on it, as 
+     * they don't use prunable part of txs.
+     */
+    void identify(ScanTx const& stx)
+    {
+        auto stx_tx = stx.get();
+
+        if (!stx_tx)
+            throw std::runtime_error("Cant parse tx blob");
+
+        identify(*stx_tx);
+    }
+
+    void reset()
+    {
+         auto b = {(std::get<unique_ptr<T>>(
+                        identifiers)->reset(), true)...};
+         (void) b;
+    }
+
      // overload to get value from tuple by type
     template <typename U>
     auto* const get() const
@@ -401,12 +806,32 @@ public:
         return std::get<No>(identifiers).get();
     }
 
-    inline auto get_tx_pub_key() const {return tx_pub_key;}
+    inline auto get_tx_pub_key() const {return tx_extra.tx_pub_key;}
+
+    inline auto const& get_tx_extra() const {return tx_extra;}
+
+    inline auto* get_derivation_cache() const 
+    {return derivation_cache.get();}
 
 private:
-    transaction const& tx;
-    public_key tx_pub_key;
-    vector<public_key> additional_tx_pub_keys;
+
+    void set_tx(transaction const& _tx)
+    {
+        tx = &_tx;
+
+        // tx public keys and payment ids are very common 
+        // for all identifiers so we get them here, parsing 
+        // tx extra once, instead of just obtaining them
+        // for each identifier seprately
+        tx_extra.set(*tx);
+    }
+
+    transaction const* tx {nullptr};
+    ParsedTxExtra tx_extra;
+
+    // on heap, so that identifiers' pointers to it
+    // stay valid when ModularIdentifier is moved
+    unique_ptr<DerivationCache> derivation_cache;
 };
 
 /**
@@ -419,6 +844,205 @@ auto make_identifier(transaction const& tx, T&&... identifiers)
                 tx, std::forward<T>(identifiers)...);
 }
 
+/**
+ * Creates ModularIdentifier without a tx, to be 
+ * used with its identify(tx) for many txs
+ */
+template<typename... T>
+auto make_identifier(unique_ptr<T>... identifiers)
+{
+    return ModularIdentifier<T...>(std::move(identifiers)...);
+}
+
+/**
+ * Tells if identifier U can identify a tx using 
+ * already extracted TxOutputs or TxInputs
+ */
+template <typename U, typename = void>
+struct identifies_tx_outputs : std::false_type {};
+
+template <typename U>
+struct identifies_tx_outputs<U, decltype(std::declval<U&>().identify(
+                    std::declval<TxOutputs const&>()))>
+    : std::true_type {};
+
+template <typename U, typename = void>
+struct identifies_tx_inputs : std::false_type {};
+
+template <typename U>
+struct identifies_tx_inputs<U, decltype(std::declval<U&>().identify(
+                    std::declval<TxInputs const&>()))>
+    : std::true_type {};
+
+/**
+ * Fused version of ModularIdentifier. Identifiers
+ * are stored by value, not through unique_ptr, and 
+ * called without virtual calls:
+ *
+ *   auto identifier = make_fused_identifier(
+ *         Output {&address, &viewkey},
+ *         GuessInput {&address, &viewkey, &mcore},
+ *         IntegratedPaymentID {&address, &viewkey});
+ *
+ *   for (auto const& tx: txs)
+ *   {
+ *       identifier.identify(tx);
+ *       auto const& outputs = identifier.get<Output>()->get();
+ *   }
+ *
+ * Which pass over the tx each identifier uses is picked
+ * at compile time from the identifier types. vout is 
+ * read only once into TxOutputs, shared by all Output
+ * identifiers, and vin only once into TxInputs, shared 
+ * by all Input identifiers. Each of them is done only 
+ * if there is an identifier using it. Key derivations 
+ * are shared through DerivationCache, so Output and 
+ * IntegratedPaymentID compute the derivation of tx 
+ * public key only once.
+ */
+template<typename... T>
+class FusedIdentifier
+{
+public:
+    tuple<T...> identifiers;
+
+    FusedIdentifier(T... args)
+        : identifiers {std::move(args)...},
+          derivation_cache {make_unique<DerivationCache>()}
+    {
+        auto b = {(std::get<T>(identifiers).set_derivation_cache(
+                        derivation_cache.get()), true)...};
+        (void) b;
+    }
+
+    /**
+     * Identifies a new tx. Results of the previous tx
+     * are removed from the identifiers first.
+     */
+    void identify(transaction const& _tx)
+    {
+        reset();
+
+        tx = &_tx;
+
+        tx_extra.set(*tx);
+
+        if (uses_tx_outputs)
+            tx_outputs.set(*tx, tx_extra);
+
+        if (uses_tx_inputs)
+            tx_inputs.set(*tx);
+
+        auto b = {(identify_with(std::get<T>(identifiers),
+                                 identifies_tx_outputs<T>{},
+                                 identifies_tx_inputs<T>{}), 
+                   true)...};
+        (void) b;
+    }
+
+    void identify(ScanTx const& stx)
+    {
+        auto stx_tx = stx.get();
+
+        if (!stx_tx)
+            throw std::runtime_error("Cant parse tx blob");
+
+        identify(*stx_tx);
+    }
+
+    void reset()
+    {
+         auto b = {(std::get<T>(identifiers).reset(), true)...};
+         (void) b;
+    }
+
+    template <typename U>
+    auto* get()
+    {
+        return &std::get<U>(identifiers);
+    }
+
+    template <typename U>
+    auto const* get() const
+    {
+        return &std::get<U>(identifiers);
+    }
+
+    template <size_t No>
+    auto* get()
+    {
+        return &std::get<No>(identifiers);
+    }
+
+    template <size_t No>
+    auto const* get() const
+    {
+        return &std::get<No>(identifiers);
+    }
+
+    inline auto get_tx_pub_key() const {return tx_extra.tx_pub_key;}
+
+    inline auto const& get_tx_extra() const {return tx_extra;}
+
+    inline auto* get_derivation_cache() const 
+    {return derivation_cache.get();}
+
+private:
+
+    static constexpr bool uses_tx_outputs 
+            = std::max({false, identifies_tx_outputs<T>::value...});
+
+    static constexpr bool uses_tx_inputs 
+            = std::max({false, identifies_tx_inputs<T>::value...});
+
+    // identifiers are called with qualified names, as 
+    // their exact types are known, so that calls are 
+    // not virtual
+
+    template <typename U>
+    void identify_with(U& identifier, std::true_type, std::false_type)
+    {
+        identifier.U::identify(tx_outputs);
+    }
+
+    template <typename U>
+    void identify_with(U& identifier, std::false_type, std::true_type)
+    {
+        identifier.U::identify(tx_inputs);
+    }
+
+    template <typename U>
+    void identify_with(U& identifier, std::false_type, std::false_type)
+    {
+        identifier.U::identify(*tx, tx_extra);
+    }
+
+    transaction const* tx {nullptr};
+    ParsedTxExtra tx_extra;
+    TxOutputs tx_outputs;
+    TxInputs tx_inputs;
+
+    // on heap, so that identifiers' pointers to it
+    // stay valid when FusedIdentifier is moved
+    unique_ptr<DerivationCache> derivation_cache;
+};
+
+template<typename... T>
+constexpr bool FusedIdentifier<T...>::uses_tx_outputs;
+
+template<typename... T>
+constexpr bool FusedIdentifier<T...>::uses_tx_inputs;
+
+/**
+ * Creates FusedIdentifier from identifiers' values
+ */
+template<typename... T>
+auto make_fused_identifier(T&&... identifiers)
+{
+    return FusedIdentifier<std::decay_t<T>...>(
+                std::forward<T>(identifiers)...);
+}
+
 template <typename T>
 auto
 calc_total_xmr(T&& infos)
@@ -433,7 +1057,7 @@ calc_total_xmr(T&& infos)
 
 
 inline std::ostream&
-operator<<(std::ostream& os, xmreg::Output::info const& _info)
+operator<<(std::ostream& os, xmreg::OutputInfo const& _info)
 {
     os << _info.idx_in_tx << ", "
        << pod_to_hex(_info.pub_key) << ", "
@@ -3,6 +3,11 @@
 #include "gtest/gtest.h"
 
 #include "../src/Account.h"
+#include "../src/SubaddressCache.h"
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
 
 #include "mocks.h"
 #include "JsonTx.h"
@@ -346,6 +351,54 @@ TEST(SUBADDRESS, AddSubAddressNoSpendkey)
 }
 
 
+TEST(SUBADDRESS, SubaddressMap)
+{
+    SubaddressMap map;
+
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.find(public_key {}), map.end());
+
+    vector<public_key> keys;
+
+    // more than initial table, so it has to grow
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        keys.push_back(rct::rct2pk(rct::pkGen()));
+
+        auto res = map.insert({keys.back(), {i / 200, i % 200}});
+
+        EXPECT_TRUE(res.second);
+        EXPECT_EQ(res.first->first, keys.back());
+    }
+
+    // existing key does not change its index
+    auto res = map.insert({keys.front(), {100, 100}});
+
+    EXPECT_FALSE(res.second);
+    EXPECT_EQ(res.first->second, (subaddress_index {0, 0}));
+
+    EXPECT_EQ(map.size(), keys.size());
+
+    for (uint32_t i = 0; i < keys.size(); ++i)
+    {
+        auto it = map.find(keys[i]);
+
+        ASSERT_NE(it, map.end());
+        EXPECT_EQ(it->second, (subaddress_index {i / 200, i % 200}));
+    }
+
+    EXPECT_EQ(map.count(rct::rct2pk(rct::pkGen())), 0);
+
+    // iteration in insertion order
+    uint32_t i {0};
+
+    for (auto const& kv: map)
+        EXPECT_EQ(kv.first, keys[i++]);
+
+    EXPECT_GT(map.memory_usage(), 
+              keys.size() * sizeof(SubaddressMap::value_type));
+}
+
 TEST(SUBADDRESS, PopulateSubaddresses)
 {
 	// monerowalletstagenet3
@@ -360,6 +413,10 @@ TEST(SUBADDRESS, PopulateSubaddresses)
 
     EXPECT_EQ(pacc->get_next_subbaddress_acc_id(), 
               PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR);
+
+    // table of 16384 slots and about 10'000 entries
+    EXPECT_LE(pacc->get_subaddress_map_memory_usage(),
+              16384 * 8 + 10'100 * sizeof(SubaddressMap::value_type));
 	
 	for (auto const& kv: *pacc)
 	{
@@ -368,6 +425,20 @@ TEST(SUBADDRESS, PopulateSubaddresses)
         //cout << *sacc << endl;
 		EXPECT_EQ(kv.first, sacc->psk());
 	}
+
+    auto idx = pacc->has_subaddress(pacc->psk());
+
+    ASSERT_TRUE(idx);
+    EXPECT_EQ(*idx, (subaddress_index {0, 0}));
+
+    auto sacc = pacc->gen_subaddress(3, 7);
+
+    idx = pacc->has_subaddress(sacc->psk());
+
+    ASSERT_TRUE(idx);
+    EXPECT_EQ(*idx, (subaddress_index {3, 7}));
+
+    EXPECT_FALSE(pacc->has_subaddress(rct::rct2pk(rct::pkGen())));
 }
 
 
@@ -397,5 +468,183 @@ TEST(SUBADDRESS, ExpandSubaddresses)
 
 }
 
+TEST(SUBADDRESS, PopulateSubaddressesOfManyAccounts)
+{
+	// monerowalletstagenet3
+	string address = "56heRv2ANffW1Py2kBkJDy8xnWqZsSrgjLygwjua2xc8Wbksead1NK1ehaYpjQhymGK4S8NPL9eLuJ16CuEJDag8Hq3RbPV";
+	string viewkey = "b45e6f38b2cd1c667459527decb438cdeadf9c64d93c8bccf40a9bf98943dc09";
+
+    auto jtx = construct_jsontx("ddff95211b53c194a16c2b8f37ae44b643b8bd46b4cb402af961ecabeb8417b2");
+
+    ASSERT_TRUE(jtx);
+
+    // populated one by one
+    auto pacc1 = make_primaryaccount(address, viewkey);
+
+    auto pacc2 = make_primaryaccount(jtx->sender.address_str(),
+                                     pod_to_hex(jtx->sender.viewkey));
+
+    ASSERT_TRUE(pacc1);
+    ASSERT_TRUE(pacc2);
+
+    pacc1->expand_subaddresses(
+            PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR + 5);
+
+    // same accounts populated together
+    auto acc1 = make_account(address, viewkey);
+    auto acc2 = make_account(jtx->sender.address_str(),
+                             pod_to_hex(jtx->sender.viewkey));
+
+    auto pacc1b = static_cast<PrimaryAccount*>(acc1.get());
+    auto pacc2b = static_cast<PrimaryAccount*>(acc2.get());
+
+    populate_subaddress_indices({pacc1b, pacc2b}, 
+            PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR, 4);
+
+    EXPECT_EQ(pacc1b->get_next_subbaddress_acc_id(), 
+              PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR);
+
+    populate_subaddress_indices({pacc1b}, 
+            PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR + 5, 3);
+
+    EXPECT_EQ(pacc1b->get_next_subbaddress_acc_id(), 
+              PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR + 5);
+
+    EXPECT_EQ(pacc1b->get_subaddress_map(), pacc1->get_subaddress_map());
+    EXPECT_EQ(pacc2b->get_subaddress_map(), pacc2->get_subaddress_map());
+
+    // single thread gives same result
+    auto acc3 = make_account(address, viewkey);
+    auto pacc3 = static_cast<PrimaryAccount*>(acc3.get());
+
+    pacc3->populate_subaddress_indices(0, 
+            PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR + 5, 1);
+
+    EXPECT_EQ(pacc3->get_subaddress_map(), pacc1->get_subaddress_map());
+}
+
+
+TEST(SUBADDRESS, SubaddressCache)
+{
+	// monerowalletstagenet3
+	string address = "56heRv2ANffW1Py2kBkJDy8xnWqZsSrgjLygwjua2xc8Wbksead1NK1ehaYpjQhymGK4S8NPL9eLuJ16CuEJDag8Hq3RbPV";
+	string viewkey = "b45e6f38b2cd1c667459527decb438cdeadf9c64d93c8bccf40a9bf98943dc09";
+
+    namespace bf = boost::filesystem;
+
+    auto cache_dir = bf::temp_directory_path() 
+                        / bf::unique_path("xmreg-subaddr-%%%%-%%%%");
+
+    auto cache = make_shared<SubaddressCache>(cache_dir.string());
+
+    // without cache
+    auto pacc = make_primaryaccount(address, viewkey);
+
+    ASSERT_TRUE(pacc);
+
+    EXPECT_FALSE(bf::exists(cache_dir));
+
+    SubaddressCache::set_default(cache);
+
+    // nothing cached yet, so its generated and saved
+    auto pacc1 = make_primaryaccount(address, viewkey);
+
+    auto cache_file = cache->file_path(pacc1->psk(), pacc1->pvk());
+
+    EXPECT_TRUE(bf::exists(cache_file));
+
+    EXPECT_EQ(pacc1->get_subaddress_map(), pacc->get_subaddress_map());
+
+    // loaded from the cache
+    auto pacc2 = make_primaryaccount(address, viewkey);
+
+    EXPECT_EQ(pacc2->get_next_subbaddress_acc_id(), 
+              PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR);
+
+    EXPECT_EQ(pacc2->get_subaddress_map(), pacc->get_subaddress_map());
+
+    // expanded subaddresses are cached only 
+    // when saved explicitly
+    pacc2->expand_subaddresses(
+            PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR + 5);
+
+    EXPECT_EQ(make_primaryaccount(address, viewkey)
+                ->get_next_subbaddress_acc_id(), 
+              PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR);
+
+    EXPECT_TRUE(pacc2->save_to_cache());
+
+    auto pacc3 = make_primaryaccount(address, viewkey);
+
+    EXPECT_EQ(pacc3->get_next_subbaddress_acc_id(), 
+              PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR + 5);
+
+    EXPECT_EQ(pacc3->get_subaddress_map(), pacc2->get_subaddress_map());
+
+    auto const& keys = *pacc->keys();
+    auto const no_of_minor = PrimaryAccount::SUBADDRESS_LOOKAHEAD_MINOR;
+
+    // primary address is not cached, as 
+    // PrimaryAccount always has it
+    SubaddressMap subaddresses;
+    subaddresses.insert({pacc->psk(), {0, 0}});
+
+    uint32_t next_acc_id {0};
+
+    // truncated file is not used, and is removed
+    bf::resize_file(cache_file, bf::file_size(cache_file) - 10);
+
+    EXPECT_FALSE(cache->load(keys, no_of_minor, 
+                             subaddresses, next_acc_id));
+
+    EXPECT_EQ(subaddresses.size(), 1);
+    EXPECT_FALSE(bf::exists(cache_file));
+
+    auto pacc4 = make_primaryaccount(address, viewkey);
+
+    EXPECT_EQ(pacc4->get_subaddress_map(), pacc->get_subaddress_map());
+
+    EXPECT_TRUE(cache->load(keys, no_of_minor, 
+                            subaddresses, next_acc_id));
+
+    EXPECT_EQ(subaddresses, pacc->get_subaddress_map());
+
+    // file with a changed entry fails its hmac
+    {
+        std::fstream file {cache_file, std::ios::binary 
+                            | std::ios::in | std::ios::out};
+
+        file.seekp(bf::file_size(cache_file) / 2);
+        file.put('x');
+    }
+
+    SubaddressMap subaddresses2;
+
+    EXPECT_FALSE(cache->load(keys, no_of_minor, 
+                             subaddresses2, next_acc_id));
+
+    EXPECT_TRUE(subaddresses2.empty());
+    EXPECT_FALSE(bf::exists(cache_file));
+
+    // map without all subaddresses is not saved
+    EXPECT_FALSE(cache->save(keys, no_of_minor, subaddresses2, 
+                             PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR));
+
+    EXPECT_FALSE(bf::exists(cache_file));
+
+    // accounts made from other accounts use the cache too
+    auto pacc5 = make_primaryaccount(make_account(address, viewkey));
+
+    ASSERT_TRUE(pacc5);
+
+    EXPECT_TRUE(bf::exists(cache_file));
+
+    EXPECT_EQ(pacc5->get_subaddress_map(), pacc->get_subaddress_map());
+
+    SubaddressCache::set_default(nullptr);
+
+    bf::remove_all(cache_dir);
+}
+
 
 }
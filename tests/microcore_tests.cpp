@@ -7,6 +7,12 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <thread>
+
 
 namespace
 {
@@ -80,4 +86,342 @@ using ::testing::internal::FilePath;
 
 
 
+TEST(MICROCORE, FetchRingMembers)
+{
+    // rings sharing offsets, with duplicated
+    // offsets and of different amounts
+    vector<xmreg::AbstractCore::ring_t> rings {
+        {0, {5, 3, 9}},
+        {1000, {3, 7}},
+        {0, {9, 1, 5, 5}},
+        {1000, {7, 2}},
+        {0, {}},
+        {20, {3}}};
+
+    // value of an output which can be checked
+    // against its ring's amount and offset
+    auto value_of = [](uint64_t amount, uint64_t offset)
+    {
+        return amount * 100 + offset;
+    };
+
+    std::map<uint64_t, vector<uint64_t>> fetched;
+
+    vector<vector<uint64_t>> values;
+
+    xmreg::fetch_ring_members(rings, values,
+        [&](uint64_t amount, vector<uint64_t> const& offsets,
+            vector<uint64_t>& amount_values)
+        {
+            EXPECT_EQ(fetched.count(amount), 0);
+
+            fetched[amount] = offsets;
+
+            for (auto offset: offsets)
+                amount_values.push_back(value_of(amount, offset));
+        });
+
+    // one fetch per amount, with sorted unique offsets
+    EXPECT_EQ(fetched.size(), 3);
+    EXPECT_EQ(fetched[0], (vector<uint64_t> {1, 3, 5, 9}));
+    EXPECT_EQ(fetched[1000], (vector<uint64_t> {2, 3, 7}));
+    EXPECT_EQ(fetched[20], (vector<uint64_t> {3}));
+
+    ASSERT_EQ(values.size(), rings.size());
+
+    for (size_t i = 0; i < rings.size(); ++i)
+    {
+        auto const& ring = rings[i];
+
+        ASSERT_EQ(values[i].size(), ring.second.size());
+
+        for (size_t j = 0; j < ring.second.size(); ++j)
+            EXPECT_EQ(values[i][j],
+                      value_of(ring.first, ring.second[j]));
+    }
+
+    // values vectors are reused for next rings
+    rings = {{1000, {7}}};
+
+    xmreg::fetch_ring_members(rings, values,
+        [&](uint64_t amount, vector<uint64_t> const& offsets,
+            vector<uint64_t>& amount_values)
+        {
+            for (auto offset: offsets)
+                amount_values.push_back(value_of(amount, offset));
+        });
+
+    ASSERT_EQ(values.size(), 1);
+    EXPECT_EQ(values[0], (vector<uint64_t> {value_of(1000, 7)}));
+
+    // missing values are not given as wrong ones
+    EXPECT_THROW(xmreg::fetch_ring_members(rings, values,
+            [](uint64_t, vector<uint64_t> const&,
+               vector<uint64_t>&) {}),
+        std::runtime_error);
+}
+
+// the tests below need a real blockchain, so they
+// do nothing unless its lmdb folder is given, e.g.,
+//
+//  XMREG_TEST_BLOCKCHAIN_PATH=~/.bitmonero/stagenet/lmdb \
+//  XMREG_TEST_NETWORK=stagenet ./microcore_tests
+
+string
+blockchain_path_from_env()
+{
+    auto path = std::getenv("XMREG_TEST_BLOCKCHAIN_PATH");
+    return path ? path : "";
+}
+
+network_type
+nettype_from_env()
+{
+    auto nettype = std::getenv("XMREG_TEST_NETWORK");
+
+    if (!nettype)
+        return network_type::MAINNET;
+
+    if (string {nettype} == "stagenet")
+        return network_type::STAGENET;
+
+    if (string {nettype} == "testnet")
+        return network_type::TESTNET;
+
+    return network_type::MAINNET;
+}
+
+// what a block reads give in a single thread
+struct block_reads
+{
+    uint64_t height;
+    vector<crypto::hash> tx_hashes;
+    vector<crypto::hash> tx_prefix_hashes;
+    vector<xmreg::AbstractCore::ring_t> rings;
+    vector<vector<output_data_t>> outputs;
+    vector<vector<tx_out_index>> indices;
+};
+
+// reads of a block with batched calls, as
+// done when scanning, or with the single item
+// ones, to give results to compare them with
+block_reads
+read_block(xmreg::MicroCore const& mcore, uint64_t height,
+           bool batched = true)
+{
+    block_reads reads {height};
+
+    block blk;
+
+    if (!mcore.get_block_from_height(height, blk))
+        throw std::runtime_error("Cant get block " 
+                                 + std::to_string(height));
+
+    reads.tx_hashes = blk.tx_hashes;
+
+    vector<transaction> txs;
+
+    if (batched)
+    {
+        vector<crypto::hash> missed_txs;
+
+        mcore.get_transactions(reads.tx_hashes, txs, missed_txs);
+
+        if (!missed_txs.empty())
+            throw std::runtime_error("Missed txs in block " 
+                                     + std::to_string(height));
+    }
+    else
+    {
+        for (auto const& tx_hash: reads.tx_hashes)
+        {
+            txs.emplace_back();
+
+            if (!mcore.get_tx(tx_hash, txs.back()))
+                throw std::runtime_error("Missed tx in block " 
+                                         + std::to_string(height));
+        }
+    }
+
+    for (auto const& tx: txs)
+    {
+        reads.tx_prefix_hashes.push_back(
+                get_transaction_prefix_hash(tx));
+
+        for (auto const& in: tx.vin)
+        {
+            if (in.type() != typeid(txin_to_key))
+                continue;
+
+            auto const& in_key = boost::get<txin_to_key>(in);
+
+            reads.rings.emplace_back(
+                    in_key.amount,
+                    relative_output_offsets_to_absolute(
+                        in_key.key_offsets));
+        }
+    }
+
+    if (batched)
+    {
+        mcore.get_output_keys(reads.rings, reads.outputs);
+        mcore.get_output_tx_and_indices(reads.rings, reads.indices);
+
+        return reads;
+    }
+
+    for (auto const& ring: reads.rings)
+    {
+        reads.outputs.emplace_back();
+        reads.indices.emplace_back();
+
+        for (auto const& offset: ring.second)
+        {
+            reads.outputs.back().push_back(
+                    mcore.get_output_key(ring.first, offset));
+
+            reads.indices.back().push_back(
+                    mcore.get_output_tx_and_index(ring.first, offset));
+        }
+    }
+
+    return reads;
+}
+
+bool
+same_outputs(vector<output_data_t> const& l,
+             vector<output_data_t> const& r)
+{
+    return std::equal(l.begin(), l.end(), r.begin(), r.end(),
+            [](output_data_t const& o1, output_data_t const& o2)
+            {
+                return o1.pubkey == o2.pubkey
+                        && o1.unlock_time == o2.unlock_time
+                        && o1.height == o2.height
+                        && o1.commitment == o2.commitment;
+            });
+}
+
+bool
+same_reads(block_reads const& l, block_reads const& r)
+{
+    if (l.outputs.size() != r.outputs.size())
+        return false;
+
+    for (size_t i = 0; i < l.outputs.size(); ++i)
+        if (!same_outputs(l.outputs[i], r.outputs[i]))
+            return false;
+
+    return l.height == r.height
+            && l.tx_hashes == r.tx_hashes
+            && l.tx_prefix_hashes == r.tx_prefix_hashes
+            && l.rings == r.rings
+            && l.indices == r.indices;
+}
+
+TEST(MICROCORE, ConcurrentReaders)
+{
+    auto blockchain_path = blockchain_path_from_env();
+
+    if (blockchain_path.empty())
+        GTEST_SKIP() << "XMREG_TEST_BLOCKCHAIN_PATH not set";
+
+    xmreg::MicroCore mcore;
+
+    ASSERT_TRUE(mcore.init(blockchain_path, nettype_from_env()));
+
+    auto height = mcore.get_current_blockchain_height();
+
+    ASSERT_GT(height, 100);
+
+    // results of reads of some recent and old
+    // blocks, made first in a single thread, with
+    // single item reads, not the batched ones
+    // which are checked
+    vector<block_reads> expected;
+
+    uint64_t const no_of_blocks {200};
+
+    for (uint64_t i = 0; i < no_of_blocks; ++i)
+        expected.push_back(read_block(
+                    mcore, 1 + i * ((height - 1) / no_of_blocks),
+                    false /*batched*/));
+
+    size_t const no_of_threads = xmreg::MicroCore::max_reader_threads();
+
+    std::atomic<uint64_t> no_of_reads {0};
+    std::atomic<uint64_t> no_of_mismatches {0};
+    std::atomic<uint64_t> no_of_errors {0};
+
+    auto reader = [&](size_t thread_no)
+    {
+        try
+        {
+            // each thread goes through the blocks
+            // in different order
+            for (size_t round = 0; round < 3; ++round)
+            {
+                for (size_t i = 0; i < expected.size(); ++i)
+                {
+                    auto const& exp = expected[
+                        (i * (thread_no + 1) + round) % expected.size()];
+
+                    auto reads = read_block(mcore, exp.height);
+
+                    // single tx and output reads
+                    for (auto const& tx_hash: exp.tx_hashes)
+                    {
+                        transaction tx;
+
+                        if (!mcore.get_tx(tx_hash, tx))
+                            ++no_of_mismatches;
+                    }
+
+                    if (!exp.rings.empty())
+                    {
+                        auto const& ring = exp.rings.front();
+
+                        vector<output_data_t> outputs;
+                        vector<tx_out_index> indices;
+
+                        mcore.get_output_key(ring.first, ring.second,
+                                             outputs);
+
+                        mcore.get_output_tx_and_index(
+                                    ring.first, ring.second, indices);
+
+                        if (!same_outputs(outputs, exp.outputs.front())
+                                || indices != exp.indices.front())
+                            ++no_of_mismatches;
+                    }
+
+                    if (!same_reads(reads, exp))
+                        ++no_of_mismatches;
+
+                    ++no_of_reads;
+                }
+            }
+        }
+        catch (std::exception const& e)
+        {
+            cerr << "Reader " << thread_no << ": " << e.what() << '\n';
+            ++no_of_errors;
+        }
+    };
+
+    vector<std::thread> readers;
+
+    for (size_t i = 0; i < no_of_threads; ++i)
+        readers.emplace_back(reader, i);
+
+    for (auto& r: readers)
+        r.join();
+
+    EXPECT_EQ(no_of_errors, 0);
+    EXPECT_EQ(no_of_mismatches, 0);
+    EXPECT_EQ(no_of_reads, no_of_threads * 3 * expected.size());
+}
+
+
+
 }
@@ -74,6 +74,14 @@ public:
                        bool(crypto::hash const& tx_hash,
                             transaction& tx));
 
+    // uses mocked get_tx above
+    bool
+    get_pruned_tx(crypto::hash const& tx_hash,
+                  transaction& tx) const override
+    {
+        return AbstractCore::get_pruned_tx(tx_hash, tx);
+    }
+
     MOCK_CONST_METHOD1(get_num_outputs, uint64_t(uint64_t));
 
     MOCK_CONST_METHOD3(get_output_key,
@@ -85,6 +93,37 @@ public:
                     output_data_t(uint64_t amount,
                                   uint64_t global_amount_index));
 
+    // batched methods use the above mocked
+    // methods for each ring
+    void
+    get_output_keys(vector<ring_t> const& rings,
+                    vector<vector<output_data_t>>& outputs) const override
+    {
+        AbstractCore::get_output_keys(rings, outputs);
+    }
+
+    void
+    get_output_tx_and_indices(
+            vector<ring_t> const& rings,
+            vector<vector<tx_out_index>>& indices) const override
+    {
+        AbstractCore::get_output_tx_and_indices(rings, indices);
+    }
+
+    // there is no blockchain db to
+    // open read transactions of
+    bool
+    start_read_txn() const override
+    {
+        return AbstractCore::start_read_txn();
+    }
+
+    void
+    stop_read_txn() const override
+    {
+        AbstractCore::stop_read_txn();
+    }
+
     MOCK_CONST_METHOD1(get_tx_amount_output_indices,
                     std::vector<uint64_t>(uint64_t tx_id));
 
@@ -103,6 +142,13 @@ public:
                        bool(vector<tx_info>& tx_infos,
                             vector<spent_key_image_info>& key_image_infos));
 
+    MOCK_CONST_METHOD1(get_mempool_tx_hashes,
+                       bool(vector<crypto::hash>& tx_hashes));
+
+    MOCK_CONST_METHOD2(get_mempool_tx,
+                       bool(crypto::hash const& tx_hash,
+                            transaction& tx));
+
 };
 
 
@@ -3,7 +3,17 @@
 
 #include <boost/iterator/filter_iterator.hpp>
 
+#include <atomic>
+#include <cstring>
+
 #include "../src/UniversalIdentifier.hpp"
+#include "../src/MultiAccountOutputScanner.h"
+#include "../src/BlockRangeScanner.h"
+#include "../src/ChainCursor.h"
+#include "../src/MempoolWatcher.h"
+#include "../src/MixinTxCache.h"
+#include "../src/OwnedOutputIndex.h"
+#include "../src/ScanArena.h"
 
 #include "mocks.h"
 #include "JsonTx.h"
@@ -220,6 +230,131 @@ TEST_P(ModularIdentifierTest, MultiOutputsRingCT)
 }
 
 
+TEST_P(ModularIdentifierTest, MultiAccountOutputScanner)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    MultiAccountOutputScanner scanner;
+
+    scanner.add(&jtx->sender.address, &jtx->sender.viewkey);
+
+    for (auto const& jrecipient: jtx->recipients)
+        scanner.add(&jrecipient.address, &jrecipient.viewkey);
+
+    ASSERT_EQ(scanner.size(), jtx->recipients.size() + 1);
+
+    // scan twice to make sure that results of
+    // previous scan are not accumulated
+    scanner.scan(jtx->tx);
+    scanner.scan(jtx->tx);
+
+    EXPECT_TRUE(scanner.get(0) == jtx->sender.outputs);
+
+    for (size_t i = 0; i < jtx->recipients.size(); ++i)
+    {
+        EXPECT_TRUE(scanner.get(i + 1)
+                    == jtx->recipients[i].outputs);
+    }
+}
+
+TEST_P(ModularIdentifierTest, OutputsWithViewTags)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    for (auto const& jrecipient: jtx->recipients)
+    {
+        auto identifier = make_identifier(jtx->tx,
+              make_unique<Output>(&jrecipient.address,
+                                  &jrecipient.viewkey));
+
+        identifier.identify();
+
+        auto const outputs = identifier.get<0>()->get();
+
+        // test txs are older than view tags. so we convert
+        // their outputs into tagged ones. our outputs get
+        // correct tags, while all other get a tag which 
+        // does not match any of our derivations, so that
+        // all of them must be rejected by the tag.
+        transaction tagged_tx = jtx->tx;
+
+        key_derivation derivation;
+
+        ASSERT_TRUE(generate_key_derivation(
+                    identifier.get_tx_pub_key(),
+                    jrecipient.viewkey, derivation));
+
+        auto const& additional_tx_pub_keys 
+            = identifier.get_tx_extra().additional_tx_pub_keys;
+
+        for (size_t i = 0; i < tagged_tx.vout.size(); ++i)
+        {
+            auto& out = tagged_tx.vout[i];
+
+            auto const& out_key 
+                = boost::get<txout_to_key>(out.target).key;
+
+            vector<crypto::view_tag> our_tags(1);
+
+            derive_view_tag(derivation, i, our_tags[0]);
+
+            if (i < additional_tx_pub_keys.size())
+            {
+                key_derivation additional_derivation;
+
+                ASSERT_TRUE(generate_key_derivation(
+                            additional_tx_pub_keys[i],
+                            jrecipient.viewkey, 
+                            additional_derivation));
+
+                our_tags.emplace_back();
+
+                derive_view_tag(additional_derivation, i, 
+                                our_tags.back());
+            }
+
+            crypto::view_tag other_tag {};
+
+            while (std::any_of(our_tags.begin(), our_tags.end(),
+                        [&](crypto::view_tag const& vt)
+                        {return vt.data == other_tag.data;}))
+                ++other_tag.data;
+
+            out.target = txout_to_tagged_key {out_key, other_tag};
+        }
+
+        for (auto const& out: outputs)
+        {
+            crypto::view_tag vt;
+            derive_view_tag(out.derivation, out.idx_in_tx, vt);
+
+            boost::get<txout_to_tagged_key>(
+                tagged_tx.vout[out.idx_in_tx].target).view_tag = vt;
+        }
+
+        auto tagged_identifier = make_identifier(tagged_tx,
+              make_unique<Output>(&jrecipient.address,
+                                  &jrecipient.viewkey));
+
+        tagged_identifier.identify();
+
+        auto const* output_identifier = tagged_identifier.get<0>();
+
+        EXPECT_TRUE(output_identifier->get() == jrecipient.outputs);
+
+        EXPECT_EQ(output_identifier->get_view_tag_rejected(),
+                  tagged_tx.vout.size() - outputs.size());
+    }
+}
+
 TEST_P(ModularIdentifierTest, LegacyPaymentID)
 {
     string tx_hash_str = GetParam();
@@ -275,6 +410,161 @@ TEST_P(ModularIdentifierTest, IntegratedPaymentID)
    }
 }
 
+TEST_P(ModularIdentifierTest, SharedDerivationCache)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    auto const& jrecipient = jtx->recipients.at(0);
+
+    auto identifier = make_identifier(jtx->tx,
+          make_unique<Output>(&jrecipient.address,
+                              &jrecipient.viewkey),
+          make_unique<IntegratedPaymentID>(
+                         &jrecipient.address,
+                         &jrecipient.viewkey));
+
+    identifier.identify();
+
+    EXPECT_TRUE(identifier.get<0>()->get() == jrecipient.outputs);
+
+    auto const* cache = identifier.get_derivation_cache();
+
+    ASSERT_TRUE(cache);
+
+    // only one derivation per tx public key
+    EXPECT_LE(cache->size(), 
+              1 + identifier.get_tx_extra()
+                    .additional_tx_pub_keys.size());
+
+    auto pid = identifier.get<1>()->get();
+
+    if (jtx->payment_id8 == crypto::null_hash8)
+    {
+        EXPECT_FALSE(pid);
+        EXPECT_EQ(cache->hits(), 0);
+    }
+    else
+    {
+        // IntegratedPaymentID used derivation
+        // already generated by Output
+        ASSERT_TRUE(pid);
+        EXPECT_TRUE(*pid == jtx->payment_id8e);
+        EXPECT_EQ(cache->hits(), 1);
+    }
+}
+
+TEST_P(ModularIdentifierTest, FusedIdentifier)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    MockMicroCore mcore;
+
+    ADD_MOCKS(mcore);
+
+    auto const& jrecipient = jtx->recipients.at(0);
+
+    auto identifier = make_fused_identifier(
+          Output {&jtx->sender.address, 
+                  &jtx->sender.viewkey},
+          GuessInput {&jtx->sender.address, 
+                      &jtx->sender.viewkey,
+                      &mcore},
+          RealInput {&jtx->sender.address, 
+                     &jtx->sender.viewkey,
+                     &jtx->sender.spendkey,
+                     &mcore},
+          IntegratedPaymentID {&jrecipient.address,
+                               &jrecipient.viewkey});
+
+    // twice, to check that results of 
+    // previous tx are removed
+    identifier.identify(jtx->tx);
+    identifier.identify(jtx->tx);
+
+    EXPECT_TRUE(identifier.get<Output>()->get() 
+                    == jtx->sender.outputs);
+
+    EXPECT_TRUE(identifier.get<RealInput>()->get() 
+                    == jtx->sender.inputs);
+
+    EXPECT_GE(identifier.get<GuessInput>()->get().size(),
+              jtx->sender.inputs.size());
+
+    auto pid = identifier.get<IntegratedPaymentID>()->get();
+
+    if (jtx->payment_id8 == crypto::null_hash8)
+    {
+        EXPECT_FALSE(pid);
+    }
+    else
+    {
+        ASSERT_TRUE(pid);
+        EXPECT_TRUE(*pid == jtx->payment_id8e);
+    }
+}
+
+TEST_P(ModularIdentifierTest, DerivationCacheWithReusedViewkey)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    auto const& jrecipient = jtx->recipients.at(0);
+
+    // keys of two accounts, one after another, 
+    // at the same addresses
+    auto address = jtx->sender.address;
+    auto viewkey = jtx->sender.viewkey;
+
+    auto identifier = make_identifier(
+          make_unique<Output>(&address, &viewkey));
+
+    identifier.identify(jtx->tx);
+
+    EXPECT_TRUE(identifier.get<Output>()->get() 
+                    == jtx->sender.outputs);
+
+    address = jrecipient.address;
+    viewkey = jrecipient.viewkey;
+
+    identifier.identify(jtx->tx);
+
+    EXPECT_TRUE(identifier.get<Output>()->get() 
+                    == jrecipient.outputs);
+}
+
+TEST_P(ModularIdentifierTest, ParsedTxExtra)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    ParsedTxExtra tx_extra;
+
+    tx_extra.set(jtx->tx);
+
+    EXPECT_EQ(tx_extra.tx_pub_key,
+              get_tx_pub_key_from_received_outs(jtx->tx));
+
+    EXPECT_EQ(tx_extra.additional_tx_pub_keys,
+              get_additional_tx_pub_keys_from_extra(jtx->tx));
+
+    EXPECT_EQ(tx_extra.payment_id, jtx->payment_id);
+    EXPECT_EQ(tx_extra.payment_id8, jtx->payment_id8);
+}
+
 TEST_P(ModularIdentifierTest, InputWithKnownOutputs)
 {
     string tx_hash_str = GetParam();
@@ -498,130 +788,542 @@ TEST_P(ModularIdentifierTest, RealInputRingCT)
 }
 
 
-TEST(Subaddresses, RegularTwoOutputTxToSubaddress)
+TEST_P(ModularIdentifierTest, ReusedForManyTxs)
 {
-    // this tx has funds for one subaddress. so we try to identify the outputs
-    // and the subaddress using primary address of the recipient
-    auto jtx = construct_jsontx("024dc13cb11d411682f04d41b52931849527d530e4cb198a63526c13da31a413");
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
 
     ASSERT_TRUE(jtx);
 
-    // recipeint primary address and viewkey
-    string const raddress {"56heRv2ANffW1Py2kBkJDy8xnWqZsSrgjLygwjua2xc8Wbksead1NK1ehaYpjQhymGK4S8NPL9eLuJ16CuEJDag8Hq3RbPV"};
-    string const rviewkey {"b45e6f38b2cd1c667459527decb438cdeadf9c64d93c8bccf40a9bf98943dc09"};
-    
-    auto racc = make_primaryaccount(raddress, rviewkey);
+    MockMicroCore mcore;
 
-    // make sure we have primary address
-    ASSERT_FALSE(racc->is_subaddress());
-    
-    racc->populate_subaddress_indices();
+    ADD_MOCKS(mcore);
 
-    auto identifier = make_identifier(jtx->tx,
-          make_unique<Output>(racc.get()));
+    auto identifier = make_identifier(
+          make_unique<Output>(&jtx->sender.address,
+                              &jtx->sender.viewkey),
+          make_unique<RealInput>(
+                    &jtx->sender.address,
+                    &jtx->sender.viewkey,
+                    &jtx->sender.spendkey,
+                    &mcore));
 
-    identifier.identify();
+    // results of previous txs must not be
+    // carried over to the next one
+    for (auto i = 0; i < 3; ++i)
+    {
+        identifier.identify(jtx->tx);
 
-    EXPECT_EQ(identifier.get<0>()->get().size(),
-              jtx->recipients.at(0).outputs.size());
+        EXPECT_TRUE(identifier.get<Output>()->get()
+                    == jtx->sender.outputs);
 
-    EXPECT_TRUE(identifier.get<0>()->get() 
-            == jtx->recipients.at(0).outputs);
+        EXPECT_EQ(identifier.get<Output>()->get_total(),
+                  jtx->sender.change);
 
-    auto const& output_info 
-        = identifier.get<0>()->get().at(0);
+        EXPECT_TRUE(identifier.get<RealInput>()->get()
+                    == jtx->sender.inputs);
+    }
 
-    EXPECT_TRUE(output_info.has_subaddress_index());
-    
-    subaddress_index expected_idx {0, 6};
+    identifier.reset();
 
-    EXPECT_EQ(output_info.subaddr_idx, expected_idx);
+    EXPECT_TRUE(identifier.get<Output>()->get().empty());
+    EXPECT_TRUE(identifier.get<RealInput>()->get().empty());
+    EXPECT_EQ(identifier.get<Output>()->get_total(), 0);
 }
 
-TEST(Subaddresses, MultiOutputTxToSubaddress)
+TEST_P(ModularIdentifierTest, ScanTx)
 {
-    // this tx has funds for few subaddress of the same primary account. 
-    // so we try to identify the outputs
-    // and the subaddresses indices using primary address of the recipient
-    auto jtx = construct_jsontx("f81ecd0381c0b89f23cffe86a799e924af7b5843c663e8c07db98a14e913585e");
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
 
     ASSERT_TRUE(jtx);
 
-    // recipeint primary address and viewkey
-    string const raddress {"56heRv2ANffW1Py2kBkJDy8xnWqZsSrgjLygwjua2xc8Wbksead1NK1ehaYpjQhymGK4S8NPL9eLuJ16CuEJDag8Hq3RbPV"};
-    string const rviewkey {"b45e6f38b2cd1c667459527decb438cdeadf9c64d93c8bccf40a9bf98943dc09"};
-    
-    auto racc = make_primaryaccount(raddress, rviewkey);
+    MockMicroCore mcore;
 
-    // make sure we have primary address
-    ASSERT_FALSE(racc->is_subaddress());
-    
-    auto identifier = make_identifier(jtx->tx,
-          make_unique<Output>(racc.get()));
-    
-    identifier.identify();
-    
-    auto const& outputs_found 
-        = identifier.get<Output>()->get();
+    ADD_MOCKS(mcore);
 
-    auto total_outputs = calc_total_xmr(outputs_found);
+    auto identifier = make_identifier(
+          make_unique<Output>(&jtx->sender.address,
+                              &jtx->sender.viewkey),
+          make_unique<RealInput>(
+                    &jtx->sender.address,
+                    &jtx->sender.viewkey,
+                    &jtx->sender.spendkey,
+                    &mcore));
 
-    uint64_t expected_total {0};
+    ScanTx stx {t_serializable_object_to_blob(jtx->tx)};
 
-    set<pair<string, string>> output_indices;
+    auto stx_tx = stx.get();
 
-    for (auto&& out: outputs_found)
-    {
-        stringstream ss;
+    ASSERT_TRUE(stx_tx);
 
-        ss << out.subaddr_idx;
+    EXPECT_EQ(stx_tx->vin.size(), jtx->tx.vin.size());
+    EXPECT_EQ(stx_tx->vout.size(), jtx->tx.vout.size());
+    EXPECT_TRUE(stx_tx->rct_signatures.p.bulletproofs.empty());
+    EXPECT_TRUE(stx_tx->signatures.empty());
 
-        output_indices.insert({pod_to_hex(out.pub_key), 
-                               ss.str()});
+    identifier.identify(stx);
 
-    }
-    
-    set<pair<string, string>> expected_indices;
+    EXPECT_TRUE(identifier.get<Output>()->get()
+                == jtx->sender.outputs);
 
-    for (auto const& jrecipient: jtx->recipients)
-    {
-        auto identifier_rec = make_identifier(jtx->tx,
-              make_unique<Output>(&jrecipient.address,
-                                  &jrecipient.viewkey));
+    EXPECT_TRUE(identifier.get<RealInput>()->get()
+                == jtx->sender.inputs);
 
-       identifier_rec.identify();
+    // blob owned by someone else
+    auto tx_blob = t_serializable_object_to_blob(jtx->tx);
 
-       auto const& output_rec
-           = identifier_rec.get<Output>()->get();
-    
-       expected_total += calc_total_xmr(output_rec);
+    ScanTx stx2;
 
+    stx2.set_blob_view(tx_blob);
 
-        for (auto&& out: output_rec)
-        {
-             stringstream ss;
+    EXPECT_TRUE(stx2.get_blob().empty());
 
-             ss << *jrecipient.subaddr_idx;
+    identifier.identify(stx2);
 
-             expected_indices.insert({pod_to_hex(out.pub_key), 
-                                      ss.str()});
-        }
-    }
+    EXPECT_TRUE(identifier.get<Output>()->get()
+                == jtx->sender.outputs);
 
-    EXPECT_EQ(total_outputs, expected_total);
+    // same ScanTx with other blob
+    stx.get_blob() = "not a tx";
+    stx.reset();
 
-    vector<decltype(output_indices)::value_type> result;
+    EXPECT_FALSE(stx.get());
 
-    std::set_symmetric_difference(output_indices.begin(),
-                                  output_indices.end(),
-                                  expected_indices.begin(),
-                                  expected_indices.end(),
-                                  std::back_inserter(result));
+    EXPECT_THROW(identifier.identify(stx), std::runtime_error);
+}
 
-    EXPECT_TRUE(result.empty());
+TEST_P(ModularIdentifierTest, DeferredCommitmentVerification)
+{
+    string tx_hash_str = GetParam();
 
-    // check if expansion of subbaddress list worked
-    EXPECT_EQ(racc->get_next_subbaddress_acc_id(),
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    CommitmentVerifier verifier;
+
+    auto identifier = make_identifier(
+          make_unique<Output>(&jtx->sender.address,
+                              &jtx->sender.viewkey));
+
+    identifier.get<Output>()->set_commitment_verifier(&verifier);
+
+    identifier.identify(jtx->tx);
+
+    // amounts are same as when verified right away
+    EXPECT_TRUE(identifier.get<Output>()->get()
+                    == jtx->sender.outputs);
+
+    if (jtx->tx.version == 2 && !is_coinbase(jtx->tx))
+    {
+        EXPECT_EQ(verifier.size(), jtx->sender.outputs.size());
+    }
+
+    EXPECT_TRUE(verifier.verify(3).empty());
+
+    if (verifier.empty())
+        return;
+
+    // output with wrong amount
+    auto found = identifier.get<Output>()->get().front();
+
+    verifier.add(found.pub_key, found.rtc_outpk, 
+                 found.amount + 1, rct::skGen());
+
+    auto failed = verifier.verify(2);
+
+    ASSERT_EQ(failed.size(), 1);
+    EXPECT_EQ(failed.front().out_pub_key, found.pub_key);
+}
+
+TEST_P(ModularIdentifierTest, SoftwareCryptoSameAsDevice)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    MockMicroCore mcore;
+
+    ADD_MOCKS(mcore);
+
+    auto identifier = make_identifier(jtx->tx,
+          make_unique<SoftwareOutput>(&jtx->sender.address,
+                                      &jtx->sender.viewkey),
+          make_unique<SoftwareRealInput>(
+                    &jtx->sender.address,
+                    &jtx->sender.viewkey,
+                    &jtx->sender.spendkey,
+                    &mcore));
+
+    identifier.identify();
+
+    EXPECT_TRUE(identifier.get<SoftwareOutput>()->get()
+                    == jtx->sender.outputs);
+
+    EXPECT_TRUE(identifier.get<SoftwareRealInput>()->get()
+                    == jtx->sender.inputs);
+}
+
+TEST_P(ModularIdentifierTest, InputsWithMixinTxCache)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    MockMicroCore mcore;
+
+    ADD_MOCKS(mcore);
+
+    MixinTxCache tx_cache;
+
+    auto guess_input = make_unique<GuessInput>(
+                    &jtx->sender.address,
+                    &jtx->sender.viewkey,
+                    &mcore);
+
+    auto real_input = make_unique<RealInput>(
+                    &jtx->sender.address,
+                    &jtx->sender.viewkey,
+                    &jtx->sender.spendkey,
+                    &mcore);
+
+    guess_input->set_tx_cache(&tx_cache);
+    real_input->set_tx_cache(&tx_cache);
+
+    auto identifier = make_identifier(jtx->tx,
+            std::move(guess_input),
+            std::move(real_input));
+
+    identifier.identify();
+
+    // RealInput should use mixins txs and outputs
+    // already scanned by GuessInput
+    if (!jtx->tx.vin.empty() 
+            && jtx->tx.vin[0].type() == typeid(txin_to_key))
+    {
+        EXPECT_GT(tx_cache.size(), 0);
+        EXPECT_GT(tx_cache.output_hits(), 0);
+    }
+
+    EXPECT_LE(tx_cache.size(), tx_cache.capacity());
+
+    EXPECT_TRUE(identifier.get<RealInput>()->get()
+                == jtx->sender.inputs);
+
+    auto const& found_inputs = identifier.get<GuessInput>()->get();
+
+    for (auto const& input: jtx->sender.inputs)
+    {
+        auto found {false};
+
+        for (auto const& found_input: found_inputs)
+            if (found_input == input)
+                found = true;
+
+        EXPECT_TRUE(found);
+    }
+}
+
+TEST_P(ModularIdentifierTest, GuessInputWithOwnedOutputIndex)
+{
+    string tx_hash_str = GetParam();
+
+    auto jtx = construct_jsontx(tx_hash_str);
+
+    ASSERT_TRUE(jtx);
+
+    // pretend that we found sender's outputs 
+    // when scanning previous txs. their global 
+    // indices are taken from rings of the inputs
+    OwnedOutputIndex owned_outputs;
+
+    map<public_key, uint64_t> global_indices;
+
+    for (auto const& in: jtx->tx.vin)
+    {
+        if (in.type() != typeid(txin_to_key))
+            continue;
+
+        auto const& in_key = boost::get<txin_to_key>(in);
+
+        auto absolute_offsets 
+            = relative_output_offsets_to_absolute(in_key.key_offsets);
+
+        for (auto const& jinput: jtx->jtx["inputs"])
+        {
+            if (jinput["amount"] != in_key.amount
+                    || jinput["absolute_offsets"] != absolute_offsets)
+                continue;
+
+            auto const& jring_members = jinput["ring_members"];
+
+            for (size_t j = 0; j < jring_members.size(); ++j)
+            {
+                public_key out_pk;
+                hex_to_pod(jring_members[j]["ouput_pk"], out_pk);
+
+                global_indices[out_pk] = absolute_offsets.at(j);
+            }
+        }
+    }
+
+    for (auto const& input: jtx->sender.inputs)
+    {
+        Output::info out {};
+        out.pub_key = input.out_pub_key;
+        out.amount = input.amount;
+
+        owned_outputs.add(out, global_indices.at(input.out_pub_key),
+                          jtx->tx.version > 1 ? 0 : input.amount);
+    }
+
+    EXPECT_EQ(owned_outputs.size(), jtx->sender.inputs.size());
+
+    for (auto const& input: jtx->sender.inputs)
+    {
+        auto const* out = owned_outputs.find(input.out_pub_key);
+        ASSERT_TRUE(out);
+        EXPECT_EQ(out->amount, input.amount);
+        EXPECT_EQ(out->global_idx, global_indices.at(input.out_pub_key));
+
+        EXPECT_EQ(owned_outputs.find(out->ring_amount, out->global_idx),
+                  out);
+    }
+
+    MockMicroCore mcore;
+
+    ADD_MOCKS(mcore);
+
+    // ring members are not read from lmdb anymore
+    EXPECT_CALL(mcore, get_tx(_, _)).Times(0);
+    EXPECT_CALL(mcore, get_output_key(_, _, _)).Times(0);
+    EXPECT_CALL(mcore, get_num_outputs(_)).Times(0);
+
+    auto identifier = make_identifier(jtx->tx,
+          make_unique<GuessInput>(
+                    &jtx->sender.address,
+                    &jtx->sender.viewkey,
+                    &mcore,
+                    &owned_outputs));
+
+    // nullptr can still be given instead of
+    // known outputs or the index
+    static_assert(std::is_constructible<GuessInput, 
+                    address_parse_info const*, secret_key const*,
+                    MicroCore*, std::nullptr_t>::value, 
+                  "GuessInput with nullptr is ambiguous");
+
+    static_assert(std::is_constructible<GuessInput, 
+                    Account*, MicroCore*, std::nullptr_t>::value, 
+                  "GuessInput with nullptr is ambiguous");
+
+    identifier.identify();
+
+    EXPECT_TRUE(identifier.get<0>()->get() == jtx->sender.inputs);
+
+    if (!jtx->sender.inputs.empty())
+    {
+        auto const& pub_key = jtx->sender.inputs[0].out_pub_key;
+
+        auto global_idx = owned_outputs.find(pub_key)->global_idx;
+        auto ring_amount = owned_outputs.find(pub_key)->ring_amount;
+
+        EXPECT_TRUE(owned_outputs.remove(pub_key));
+        EXPECT_FALSE(owned_outputs.find(pub_key));
+        EXPECT_FALSE(owned_outputs.find(ring_amount, global_idx));
+    }
+}
+
+TEST(MixinTxCache, LeastRecentlyUsedTxsAreRemoved)
+{
+    auto jtx = construct_jsontx("ddff95211b53c194a16c2b8f37ae44b643b8bd46b4cb402af961ecabeb8417b2");
+
+    ASSERT_TRUE(jtx);
+
+    MockMicroCore mcore;
+
+    EXPECT_CALL(mcore, get_tx(_, _))
+            .WillRepeatedly(DoAll(SetArgReferee<1>(jtx->tx), 
+                                  Return(true)));
+
+    MixinTxCache tx_cache {2};
+
+    auto h1 = crypto::rand<crypto::hash>();
+    auto h2 = crypto::rand<crypto::hash>();
+    auto h3 = crypto::rand<crypto::hash>();
+
+    EXPECT_TRUE(tx_cache.get_tx(h1, &mcore));
+    EXPECT_TRUE(tx_cache.get_tx(h2, &mcore));
+
+    // h1 is now most recently used, so h2 
+    // is going to be removed when h3 is added
+    EXPECT_TRUE(tx_cache.get_tx(h1, &mcore));
+    EXPECT_TRUE(tx_cache.get_tx(h3, &mcore));
+
+    EXPECT_EQ(tx_cache.size(), 2);
+    EXPECT_EQ(tx_cache.hits(), 1);
+    EXPECT_EQ(tx_cache.misses(), 3);
+
+    MixinTxCache::account_key_t acc_key {
+        jtx->sender.address.address.m_spend_public_key, 
+        jtx->sender.address.address.m_view_public_key, 
+        false};
+
+    vector<Output::info> outputs;
+
+    // outputs are not saved for txs not in the cache
+    tx_cache.set_outputs(h2, acc_key, {Output::info {}});
+    EXPECT_FALSE(tx_cache.get_outputs(h2, acc_key, outputs));
+
+    tx_cache.set_outputs(h1, acc_key, {Output::info {}});
+    EXPECT_TRUE(tx_cache.get_outputs(h1, acc_key, outputs));
+    EXPECT_EQ(outputs.size(), 1);
+
+    // same spend key, but other viewkey, 
+    // does not share the outputs
+    MixinTxCache::account_key_t other_viewkey_acc_key {
+        jtx->sender.address.address.m_spend_public_key, 
+        crypto::rand<public_key>(), 
+        false};
+
+    EXPECT_FALSE(tx_cache.get_outputs(h1, other_viewkey_acc_key, 
+                                      outputs));
+
+    EXPECT_TRUE(tx_cache.get_tx(h2, &mcore));
+    EXPECT_EQ(tx_cache.misses(), 4);
+}
+
+TEST(Subaddresses, RegularTwoOutputTxToSubaddress)
+{
+    // this tx has funds for one subaddress. so we try to identify the outputs
+    // and the subaddress using primary address of the recipient
+    auto jtx = construct_jsontx("024dc13cb11d411682f04d41b52931849527d530e4cb198a63526c13da31a413");
+
+    ASSERT_TRUE(jtx);
+
+    // recipeint primary address and viewkey
+    string const raddress {"56heRv2ANffW1Py2kBkJDy8xnWqZsSrgjLygwjua2xc8Wbksead1NK1ehaYpjQhymGK4S8NPL9eLuJ16CuEJDag8Hq3RbPV"};
+    string const rviewkey {"b45e6f38b2cd1c667459527decb438cdeadf9c64d93c8bccf40a9bf98943dc09"};
+    
+    auto racc = make_primaryaccount(raddress, rviewkey);
+
+    // make sure we have primary address
+    ASSERT_FALSE(racc->is_subaddress());
+    
+    racc->populate_subaddress_indices();
+
+    auto identifier = make_identifier(jtx->tx,
+          make_unique<Output>(racc.get()));
+
+    identifier.identify();
+
+    EXPECT_EQ(identifier.get<0>()->get().size(),
+              jtx->recipients.at(0).outputs.size());
+
+    EXPECT_TRUE(identifier.get<0>()->get() 
+            == jtx->recipients.at(0).outputs);
+
+    auto const& output_info 
+        = identifier.get<0>()->get().at(0);
+
+    EXPECT_TRUE(output_info.has_subaddress_index());
+    
+    subaddress_index expected_idx {0, 6};
+
+    EXPECT_EQ(output_info.subaddr_idx, expected_idx);
+}
+
+TEST(Subaddresses, MultiOutputTxToSubaddress)
+{
+    // this tx has funds for few subaddress of the same primary account. 
+    // so we try to identify the outputs
+    // and the subaddresses indices using primary address of the recipient
+    auto jtx = construct_jsontx("f81ecd0381c0b89f23cffe86a799e924af7b5843c663e8c07db98a14e913585e");
+
+    ASSERT_TRUE(jtx);
+
+    // recipeint primary address and viewkey
+    string const raddress {"56heRv2ANffW1Py2kBkJDy8xnWqZsSrgjLygwjua2xc8Wbksead1NK1ehaYpjQhymGK4S8NPL9eLuJ16CuEJDag8Hq3RbPV"};
+    string const rviewkey {"b45e6f38b2cd1c667459527decb438cdeadf9c64d93c8bccf40a9bf98943dc09"};
+    
+    auto racc = make_primaryaccount(raddress, rviewkey);
+
+    // make sure we have primary address
+    ASSERT_FALSE(racc->is_subaddress());
+    
+    auto identifier = make_identifier(jtx->tx,
+          make_unique<Output>(racc.get()));
+    
+    identifier.identify();
+    
+    auto const& outputs_found 
+        = identifier.get<Output>()->get();
+
+    auto total_outputs = calc_total_xmr(outputs_found);
+
+    uint64_t expected_total {0};
+
+    set<pair<string, string>> output_indices;
+
+    for (auto&& out: outputs_found)
+    {
+        stringstream ss;
+
+        ss << out.subaddr_idx;
+
+        output_indices.insert({pod_to_hex(out.pub_key), 
+                               ss.str()});
+
+    }
+    
+    set<pair<string, string>> expected_indices;
+
+    for (auto const& jrecipient: jtx->recipients)
+    {
+        auto identifier_rec = make_identifier(jtx->tx,
+              make_unique<Output>(&jrecipient.address,
+                                  &jrecipient.viewkey));
+
+       identifier_rec.identify();
+
+       auto const& output_rec
+           = identifier_rec.get<Output>()->get();
+    
+       expected_total += calc_total_xmr(output_rec);
+
+
+        for (auto&& out: output_rec)
+        {
+             stringstream ss;
+
+             ss << *jrecipient.subaddr_idx;
+
+             expected_indices.insert({pod_to_hex(out.pub_key), 
+                                      ss.str()});
+        }
+    }
+
+    EXPECT_EQ(total_outputs, expected_total);
+
+    vector<decltype(output_indices)::value_type> result;
+
+    std::set_symmetric_difference(output_indices.begin(),
+                                  output_indices.end(),
+                                  expected_indices.begin(),
+                                  expected_indices.end(),
+                                  std::back_inserter(result));
+
+    EXPECT_TRUE(result.empty());
+
+    // check if expansion of subbaddress list worked
+    EXPECT_EQ(racc->get_next_subbaddress_acc_id(),
               PrimaryAccount::SUBADDRESS_LOOKAHEAD_MAJOR + 49);
 
     EXPECT_EQ(racc->get_subaddress_map().size(), 10'000 + 49*200);
@@ -738,4 +1440,469 @@ TEST(Subaddresses, RealInputsToSubaddress)
    EXPECT_TRUE(found_inputs == expected_inputs);
 }
 
+
+TEST(Subaddresses, SoftwareRealInputsToSubaddress)
+{
+    auto jtx = construct_jsontx("e658966b256ca30c85848751ff986e3ba7c7cfdadeb46ee1a845a042b3da90db");
+
+    ASSERT_TRUE(jtx);
+    
+    MockMicroCore mcore;
+    ADD_MOCKS(mcore);
+
+    string const sender_addr = jtx->sender.address_str();
+    string const sender_viewkey = pod_to_hex(jtx->sender.viewkey);
+    string const sender_spendkey = pod_to_hex(jtx->sender.spendkey);
+
+    auto sender = make_primaryaccount(sender_addr, 
+                                      sender_viewkey,
+                                      sender_spendkey);
+
+    // key images of outputs to subaddresses are
+    // generated without hw::device
+    auto identifier = make_identifier(jtx->tx,
+          make_unique<RealInput>(sender.get(), &mcore),
+          make_unique<SoftwareRealInput>(sender.get(), &mcore));
+
+   identifier.identify();
+   
+   auto const& expected_inputs = identifier.get<RealInput>()->get();
+   auto const& found_inputs = identifier.get<SoftwareRealInput>()->get();
+
+   EXPECT_TRUE(found_inputs == expected_inputs);
+}
+
+TEST(BlockRangeScanner, ResultsInHeightOrder)
+{
+    auto jtx = construct_jsontx("ddff95211b53c194a16c2b8f37ae44b643b8bd46b4cb402af961ecabeb8417b2");
+
+    ASSERT_TRUE(jtx);
+
+    MockMicroCore mcore;
+
+    // each block has the jtx as its only non-coinbase tx
+    EXPECT_CALL(mcore, get_blocks_range(_, _))
+            .WillRepeatedly(Invoke(
+                [&](uint64_t h1, uint64_t h2)
+                {
+                    block blk;
+                    blk.tx_hashes.push_back(jtx->tx_hash);
+                    return vector<block>(h2 - h1 + 1, blk);
+                }));
+
+    EXPECT_CALL(mcore, get_transactions(_, _, _))
+            .WillRepeatedly(Invoke(
+                [&](vector<crypto::hash> const& txs_ids,
+                    vector<transaction>& txs,
+                    vector<crypto::hash>& missed_txs)
+                {
+                    txs.assign(txs_ids.size(), jtx->tx);
+                    return true;
+                }));
+
+    BlockRangeScanner<pair<uint64_t, size_t>> scanner {
+        &mcore, 4 /*threads*/, 3 /*chunk size*/};
+
+    vector<uint64_t> heights;
+
+    auto scanned_all = scanner.scan(10, 31,
+        [&](uint64_t height, block const& blk,
+            vector<transaction> const& txs)
+        {
+            auto identifier = make_identifier(txs.back(),
+                  make_unique<Output>(&jtx->sender.address,
+                                      &jtx->sender.viewkey));
+            identifier.identify();
+
+            return make_pair(height, 
+                             identifier.get<0>()->get().size());
+        },
+        [&](uint64_t height, pair<uint64_t, size_t>& result)
+        {
+            EXPECT_EQ(height, result.first);
+            EXPECT_EQ(result.second, jtx->sender.outputs.size());
+            heights.push_back(height);
+            return true;
+        });
+
+    EXPECT_TRUE(scanned_all);
+
+    ASSERT_EQ(heights.size(), 21);
+
+    for (size_t i = 0; i < heights.size(); ++i)
+        EXPECT_EQ(heights[i], 10 + i);
+
+    // stop scanning in the middle of the range
+    heights.clear();
+
+    scanned_all = scanner.scan(0, 100,
+        [&](uint64_t height, block const&, vector<transaction> const&)
+        {
+            return make_pair(height, size_t {0});
+        },
+        [&](uint64_t height, pair<uint64_t, size_t>&)
+        {
+            heights.push_back(height);
+            return height < 7;
+        });
+
+    EXPECT_FALSE(scanned_all);
+    EXPECT_EQ(heights.size(), 8);
+}
+
+// block at height h has (h % 3) + 1 non-coinbase txs.
+// each tx, including coinbase, has h * 100 + its index in
+// the block as its unlock_time, and the same number in its
+// hash, so that it can be checked which block it came with
+static crypto::hash
+chain_cursor_tx_hash(uint64_t height, uint64_t i)
+{
+    crypto::hash tx_hash = crypto::null_hash;
+    uint64_t id = height * 100 + i;
+    std::memcpy(tx_hash.data, &id, sizeof(id));
+    return tx_hash;
+}
+
+static void
+add_chain_cursor_mocks(MockMicroCore& mcore,
+                       std::atomic<uint64_t>& last_fetched,
+                       uint64_t failing_height = UINT64_MAX)
+{
+    EXPECT_CALL(mcore, get_blocks_range(_, _))
+            .WillRepeatedly(Invoke(
+                [&](uint64_t h1, uint64_t h2)
+                {
+                    vector<block> blocks;
+
+                    for (auto height = h1; height <= h2; ++height)
+                    {
+                        block blk;
+                        blk.timestamp = height;
+                        blk.miner_tx.unlock_time = height * 100;
+
+                        for (uint64_t i = 1; i <= height % 3 + 1; ++i)
+                            blk.tx_hashes.push_back(
+                                    chain_cursor_tx_hash(height, i));
+
+                        blocks.push_back(std::move(blk));
+                    }
+
+                    last_fetched = h2;
+
+                    return blocks;
+                }));
+
+    EXPECT_CALL(mcore, get_transactions(_, _, _))
+            .WillRepeatedly(Invoke(
+                [=](vector<crypto::hash> const& txs_ids,
+                    vector<transaction>& txs,
+                    vector<crypto::hash>& missed_txs)
+                {
+                    for (auto const& tx_hash: txs_ids)
+                    {
+                        uint64_t id;
+                        std::memcpy(&id, tx_hash.data, sizeof(id));
+
+                        if (id / 100 >= failing_height)
+                            return false;
+
+                        transaction tx;
+                        tx.unlock_time = id;
+                        txs.push_back(std::move(tx));
+                    }
+
+                    return true;
+                }));
+}
+
+TEST(ChainCursor, BlocksInHeightOrderWithTheirTxs)
+{
+    MockMicroCore mcore;
+
+    std::atomic<uint64_t> last_fetched {0};
+
+    add_chain_cursor_mocks(mcore, last_fetched);
+
+    ChainCursor cursor {&mcore, 10, 33,
+                        4 /*max blocks ahead*/, 3 /*batch size*/};
+
+    uint64_t expected_height {10};
+
+    while (auto entry = cursor.next())
+    {
+        EXPECT_EQ(entry->height, expected_height);
+        EXPECT_EQ(entry->blk.timestamp, expected_height);
+
+        ASSERT_EQ(entry->txs.size(), expected_height % 3 + 2);
+
+        for (uint64_t i = 0; i < entry->txs.size(); ++i)
+            EXPECT_EQ(entry->txs[i].unlock_time,
+                      expected_height * 100 + i);
+
+        ++expected_height;
+    }
+
+    EXPECT_EQ(expected_height, 33);
+    EXPECT_EQ(last_fetched, 32);
+
+    // no more blocks
+    EXPECT_EQ(cursor.next(), nullptr);
+}
+
+TEST(ChainCursor, StopsEarly)
+{
+    MockMicroCore mcore;
+
+    std::atomic<uint64_t> last_fetched {0};
+
+    add_chain_cursor_mocks(mcore, last_fetched);
+
+    {
+        ChainCursor cursor {&mcore, 0, 1000,
+                            5 /*max blocks ahead*/, 2 /*batch size*/};
+
+        for (uint64_t height = 0; height < 3; ++height)
+        {
+            auto entry = cursor.next();
+            ASSERT_NE(entry, nullptr);
+            EXPECT_EQ(entry->height, height);
+        }
+
+        // the cursor is destroyed here, which joins
+        // the prefetch thread. if the thread did not
+        // exit, the test would hang.
+    }
+
+    // prefetching stayed bounded: at most max blocks
+    // ahead plus one batch past the consumed ones
+    EXPECT_LE(last_fetched, 2 + 5 + 2);
+}
+
+TEST(ChainCursor, FailedGetTransactionsReachesConsumer)
+{
+    MockMicroCore mcore;
+
+    std::atomic<uint64_t> last_fetched {0};
+
+    // txs of block 7 can't be found, so the batch
+    // [6, 8) fails and blocks from 6 are not given
+    add_chain_cursor_mocks(mcore, last_fetched, 7);
+
+    ChainCursor cursor {&mcore, 0, 20,
+                        10 /*max blocks ahead*/, 2 /*batch size*/};
+
+    // blocks fetched before the error are given first
+    for (uint64_t height = 0; height < 6; ++height)
+    {
+        auto entry = cursor.next();
+        ASSERT_NE(entry, nullptr);
+        EXPECT_EQ(entry->height, height);
+    }
+
+    EXPECT_THROW(cursor.next(), std::runtime_error);
+
+    // the prefetch thread stopped at the error
+    EXPECT_EQ(cursor.next(), nullptr);
+}
+
+TEST(MempoolWatcher, ScansOnlyNewTxs)
+{
+    vector<unique_ptr<JsonTx>> jtxs;
+
+    for (auto const& tx_hash: {
+            "ddff95211b53c194a16c2b8f37ae44b643b8bd46b4cb402af961ecabeb8417b2",
+            "f3c84fe925292ec5b4dc383d306d934214f4819611566051bca904d1cf4efceb",
+            "d7dcb2daa64b5718dad71778112d48ad62f4d5f54337037c420cb76efdd8a21c"})
+    {
+        auto jtx = construct_jsontx(tx_hash);
+        ASSERT_TRUE(jtx);
+        jtxs.push_back(make_unique<JsonTx>(std::move(*jtx)));
+    }
+
+    auto const& tx1 = *jtxs[0];
+    auto const& tx2 = *jtxs[1];
+    auto const& tx3 = *jtxs[2];
+
+    MockMicroCore mcore;
+
+    vector<crypto::hash> mempool;
+
+    EXPECT_CALL(mcore, get_mempool_tx_hashes(_))
+            .WillRepeatedly(Invoke(
+                [&](vector<crypto::hash>& tx_hashes)
+                {
+                    tx_hashes = mempool;
+                    return true;
+                }));
+
+    EXPECT_CALL(mcore, get_mempool_tx(_, _))
+            .WillRepeatedly(Invoke(
+                [&](crypto::hash const& tx_hash, transaction& tx)
+                {
+                    for (auto const& jtx: jtxs)
+                        if (jtx->tx_hash == tx_hash)
+                        {
+                            tx = jtx->tx;
+                            return true;
+                        }
+
+                    return false;
+                }));
+
+    // outputs of the first tx's sender 
+    auto identifier = make_identifier(
+          make_unique<Output>(&tx1.sender.address,
+                              &tx1.sender.viewkey));
+
+    MempoolWatcher<vector<Output::info>> watcher {&mcore,
+        [&](crypto::hash const&, transaction const& tx)
+        {
+            identifier.identify(tx);
+            return identifier.get<Output>()->get();
+        }};
+
+    vector<crypto::hash> added;
+    vector<crypto::hash> removed;
+
+    auto added_f = [&](crypto::hash const& tx_hash,
+                       vector<Output::info> const&)
+                   {added.push_back(tx_hash);};
+
+    auto removed_f = [&](crypto::hash const& tx_hash,
+                         vector<Output::info> const&)
+                     {removed.push_back(tx_hash);};
+
+    mempool = {tx1.tx_hash, tx2.tx_hash};
+
+    EXPECT_TRUE(watcher.poll(added_f, removed_f));
+
+    EXPECT_EQ(watcher.no_of_scanned(), 2);
+    EXPECT_EQ(added, mempool);
+    EXPECT_TRUE(removed.empty());
+
+    EXPECT_TRUE(watcher.get_results().at(tx1.tx_hash) 
+                == tx1.sender.outputs);
+
+    // nothing changed
+    added.clear();
+
+    EXPECT_TRUE(watcher.poll(added_f, removed_f));
+
+    EXPECT_EQ(watcher.no_of_scanned(), 0);
+    EXPECT_TRUE(added.empty());
+    EXPECT_TRUE(removed.empty());
+
+    // first tx mined, new one arrived, and one 
+    // which left the mempool before it was read
+    crypto::hash unknown_tx_hash {};
+
+    mempool = {tx2.tx_hash, tx3.tx_hash, unknown_tx_hash};
+
+    EXPECT_TRUE(watcher.poll(added_f, removed_f));
+
+    EXPECT_EQ(watcher.no_of_scanned(), 1);
+    EXPECT_EQ(added, (vector<crypto::hash> {tx3.tx_hash}));
+    EXPECT_EQ(removed, (vector<crypto::hash> {tx1.tx_hash}));
+
+    EXPECT_EQ(watcher.size(), 2);
+    EXPECT_EQ(watcher.get_results().count(tx1.tx_hash), 0);
+}
+
+
+TEST(ScanArena, KeepsResultsOfManyTxs)
+{
+    vector<string> const tx_hashes {
+        "ddff95211b53c194a16c2b8f37ae44b643b8bd46b4cb402af961ecabeb8417b2",
+        "f3c84fe925292ec5b4dc383d306d934214f4819611566051bca904d1cf4efceb",
+        "386ac4fbf7d3d2ab6fd4f2d9c2e97d00527ca2867e33cd7aedb1fd05a4b791ec"};
+
+    // small blocks, so that results of
+    // the txs don't fit into one block
+    ScanArena arena {512};
+
+    for (auto pass = 0; pass < 2; ++pass)
+    {
+        vector<JsonTx> jtxs;
+
+        for (auto const& tx_hash: tx_hashes)
+        {
+            auto jtx = construct_jsontx(tx_hash);
+
+            ASSERT_TRUE(jtx);
+
+            jtxs.push_back(std::move(*jtx));
+        }
+
+        // results of each recipient of each tx, with
+        // its tx's and recipient's indices
+        vector<epee::span<Output::info const>> results;
+        vector<pair<size_t, size_t>> result_recipients;
+
+        for (size_t i = 0; i < jtxs.size(); ++i)
+        {
+            auto const& jtx = jtxs[i];
+
+            for (size_t r = 0; r < jtx.recipients.size(); ++r)
+            {
+                auto const& jrecipient = jtx.recipients[r];
+
+                auto identifier = make_identifier(
+                      make_unique<Output>(&jrecipient.address,
+                                          &jrecipient.viewkey));
+
+                identifier.identify(jtx.tx);
+
+                auto const* outputs = &identifier.get<Output>()->get();
+
+                results.push_back(arena.copy(*outputs));
+                result_recipients.emplace_back(i, r);
+
+                // get() gives results of the identifier itself,
+                // not their copy, and the same buffer is reused
+                // for next txs
+                identifier.identify(jtx.tx);
+
+                EXPECT_EQ(&identifier.get<Output>()->get(), outputs);
+            }
+        }
+
+        ASSERT_FALSE(results.empty());
+
+        // results are still there, and same as expected,
+        // after their identifiers are gone
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            auto const& jrecipient = jtxs[result_recipients[k].first]
+                    .recipients[result_recipients[k].second];
+
+            vector<Output::info> result(results[k].begin(),
+                                        results[k].end());
+
+            EXPECT_TRUE(result == jrecipient.outputs);
+        }
+
+        EXPECT_GT(arena.size(), 0);
+
+        auto capacity = arena.capacity();
+        auto no_of_blocks = arena.no_of_blocks();
+
+        arena.release();
+
+        EXPECT_EQ(arena.size(), 0);
+
+        // memory is kept for next pass
+        EXPECT_EQ(arena.capacity(), capacity);
+        EXPECT_EQ(arena.no_of_blocks(), no_of_blocks);
+    }
+
+    // values bigger than arena's blocks
+    auto big = arena.allocate<uint64_t>(1'000);
+
+    ASSERT_EQ(big.size(), 1'000);
+
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(big.data()) 
+                % alignof(uint64_t), 0);
+}
+
+
 }